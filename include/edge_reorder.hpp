@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Renumbers edges so ids follow a Hilbert curve over the edge bounding-box
+// centers. Edges that are close on the map get close ids, so the graph's
+// per-edge arrays, the geometry buffer and the spatial index payloads touched
+// by one query sit in few cache lines and pages.
+//
+// Internal ids are dense: edges with geometry come first in curve order,
+// then edges that only appear in the shortcut table, by original id.
+struct EdgeOrdering {
+    static constexpr uint32_t UNKNOWN = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> original_ids;                   // internal -> original
+    std::unordered_map<uint32_t, uint32_t> internal_ids;  // original -> internal
+
+    uint32_t to_original(uint32_t id) const {
+        return id < original_ids.size() ? original_ids[id] : id;
+    }
+    // UNKNOWN for ids not in the dataset
+    uint32_t to_internal(uint32_t id) const {
+        auto it = internal_ids.find(id);
+        return it == internal_ids.end() ? UNKNOWN : it->second;
+    }
+};
+
+// Write renumbered copies of a dataset: edges.csv rows in curve order with
+// the id column rewritten, and the shortcut table with incoming_edge,
+// outgoing_edge and via_edge remapped. Throws std::runtime_error on
+// unreadable input.
+EdgeOrdering reorder_edges_hilbert(const std::string& shortcuts_in, const std::string& edges_in,
+                                   const std::string& shortcuts_out, const std::string& edges_out);
+
+// Renumbered copies of a dataset kept in a cache directory
+struct ReorderedDataset {
+    EdgeOrdering ordering;
+    std::string shortcuts_path;
+    std::string edges_path;
+    bool rebuilt = false; // False when the cached copies were reused
+};
+
+// reorder_edges_hilbert with the result cached in cache_dir (created if
+// missing): shortcuts.parquet, edges.csv, the internal -> original id table
+// and a stamp of the inputs' paths, sizes and mtimes. While the stamp
+// matches, only the id table is read. Files are written under temporary
+// names and renamed into place, the stamp last, so an interrupted rebuild
+// is redone on the next call. Throws if cache_dir is not writable; see
+// reorder_cache_dirs for where to try next.
+ReorderedDataset reorder_edges_hilbert_cached(const std::string& shortcuts_in, const std::string& edges_in,
+                                              const std::string& cache_dir);
+
+// Cache directories for a dataset's renumbered copies, in the order to try:
+// "hilbert" beside the shortcut table, then one under the system temp
+// directory for read-only dataset directories, named after the dataset
+// directory plus a hash of both input paths. Either holds a stamp of the
+// inputs, so a change to them rebuilds the copies in place.
+std::vector<std::string> reorder_cache_dirs(const std::string& shortcuts_in, const std::string& edges_in);
+
+// The cached copies if cache_dir holds a complete cache of these inputs;
+// reads only the id table and never writes
+std::optional<ReorderedDataset> find_reordered_cached(const std::string& shortcuts_in, const std::string& edges_in,
+                                                     const std::string& cache_dir);
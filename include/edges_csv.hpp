@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parsing helpers for the pipeline's edges.csv
+
+// Points of a WKT LINESTRING ("lon lat, ...") as (lat, lon); empty if malformed
+std::vector<std::pair<double, double>> parse_wkt_linestring(const std::string& wkt);
+
+// Split one CSV line on commas outside double quotes; quotes are dropped
+std::vector<std::string> parse_csv_line(const std::string& line);
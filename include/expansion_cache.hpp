@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Bounded cache of unpacked shortcuts: (from, to) edge pair -> base-edge span.
+// Keys are spread over shards by hash, each with its own lock, LRU list and
+// an equal share of the byte budget, so concurrent queries rarely contend.
+// Within a shard, entries are evicted least recently used first once its
+// share is exceeded. Entries hit at least pin_hits times are pinned (never
+// evicted) while pinned entries stay within half of the share.
+class ShortcutExpansionCache {
+public:
+    explicit ShortcutExpansionCache(size_t budget_bytes = 64u << 20, uint32_t pin_hits = 32,
+                                    size_t shards = 16);
+
+    // Append the cached span for (from, to) to out, skipping its first `skip`
+    // edges. Returns false on a miss.
+    bool append(uint32_t from, uint32_t to, std::vector<uint32_t>& out, size_t skip = 0);
+
+    void insert(uint32_t from, uint32_t to, const std::vector<uint32_t>& base_edges);
+
+    nlohmann::json stats() const;
+
+private:
+    struct Entry {
+        std::vector<uint32_t> base_edges;
+        uint64_t hits = 0;
+        bool pinned = false;
+        std::list<uint64_t>::iterator lru_it;
+    };
+
+    // Own cache line each, so shard locks do not false-share
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, Entry> entries;
+        std::list<uint64_t> lru; // Unpinned keys, most recently used first
+        size_t bytes = 0;
+        size_t pinned_bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    static uint64_t key(uint32_t from, uint32_t to) {
+        return (static_cast<uint64_t>(from) << 32) | to;
+    }
+    static size_t entry_bytes(const Entry& entry) {
+        return sizeof(Entry) + sizeof(uint64_t) + entry.base_edges.size() * sizeof(uint32_t);
+    }
+    Shard& shard_of(uint64_t k) {
+        // Fibonacci hashing: neighbouring edge ids land in different shards
+        return shards_[(k * 0x9E3779B97F4A7C15ull >> 32) % shard_count_];
+    }
+    void evict_to_budget(Shard& shard);
+
+    size_t budget_bytes_;
+    size_t shard_budget_bytes_;
+    uint32_t pin_hits_;
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+};
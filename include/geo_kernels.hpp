@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Distance kernels over (lat, lon) polylines, as stored in the geometry arrays.
+// point_polylines_distance_m dispatches to an AVX2 kernel at runtime when the
+// CPU supports it and falls back to the scalar loop otherwise.
+
+// Great-circle distance in meters
+double haversine_m(double lat1, double lon1, double lat2, double lon2);
+
+// Sum of haversine distances between consecutive points
+double polyline_length_m(const std::pair<double, double>* points, size_t count);
+
+// Distance in meters from (lat, lon) to the nearest segment of a polyline,
+// using a local equirectangular projection around the query point
+double point_polyline_distance_m(double lat, double lon,
+                                 const std::pair<double, double>* points, size_t count);
+
+// One polyline of a batch
+struct PolylineRef {
+    const std::pair<double, double>* points;
+    size_t count;
+};
+
+// point_polyline_distance_m for n polylines at once, out[i] for polylines[i].
+// The segments of all polylines are packed into one structure-of-arrays
+// buffer and measured four at a time, so road edges of 2-4 points fill the
+// vector lanes as well as long ones. Empty polylines get the largest double.
+void point_polylines_distance_m(double lat, double lon, const PolylineRef* polylines, size_t n, double* out);
+
+// Per-polyline scalar reference of point_polylines_distance_m (exposed for tests)
+void point_polylines_distance_m_scalar(double lat, double lon, const PolylineRef* polylines, size_t n,
+                                       double* out);
+
+// True if the AVX2 kernel is used on this machine
+bool geo_kernels_use_avx2();
+
+// Position of (x, y) on a Hilbert curve filling a 2^16 x 2^16 grid
+uint64_t hilbert_index(uint32_t x, uint32_t y);
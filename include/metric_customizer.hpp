@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Recomputes shortcut costs after base-edge cost changes, in the spirit of
+// customizable CH. Only the shortcut table's columns (incoming_edge,
+// outgoing_edge, cost, via_edge) are kept, as plain vectors.
+//
+// A base shortcut (no via edge) costs the traversal of its incoming edge, so
+// overriding edge A replaces the cost of every base shortcut leaving A.
+// Every other shortcut A -> C becomes the cheapest triangle A -> B -> C over
+// all rows A -> B and B -> C in the table whose middle edge B lies below
+// both A and C in the hierarchy, and its via edge moves to that B. The
+// hierarchy is derived from the via edges chosen during preprocessing: an
+// edge sits above every edge a shortcut touching it goes through.
+// Shortcuts are relaxed bottom-up, one level at a time, with each level
+// processed in parallel.
+class MetricCustomizer {
+public:
+    // Throws std::runtime_error if the table cannot be read
+    explicit MetricCustomizer(const std::string& shortcuts_path);
+
+    struct UpdateStats {
+        size_t overrides = 0;
+        size_t base_updated = 0;
+        size_t shortcuts_updated = 0;
+        size_t vias_changed = 0;
+        size_t levels = 0;
+    };
+
+    // Apply cost overrides on top of the previous ones (or on top of the
+    // original costs when reset is set) and relax affected shortcuts
+    UpdateStats apply(const std::vector<std::pair<uint32_t, double>>& overrides, bool reset, int threads);
+
+    // Table rows whose cost or via edge the last apply() changed
+    const std::vector<uint32_t>& changed_rows() const { return changed_; }
+
+    // Write the table with the current costs and via edges to path. Every
+    // other column is copied from the source file, one row group at a time.
+    // Throws std::runtime_error if the source no longer matches.
+    void write(const std::string& path) const;
+
+    // Current cost and via edge per shortcut, in table row order
+    const std::vector<double>& costs() const { return cost_; }
+    const std::vector<int64_t>& vias() const { return via_; }
+
+    // Resident size of the vectors below
+    size_t memory_bytes() const;
+
+private:
+    std::string shortcuts_path_;
+    std::vector<int64_t> from_;
+    std::vector<int64_t> to_;
+    std::vector<int64_t> original_via_;
+    std::vector<int64_t> via_;
+    std::vector<double> original_cost_;
+    std::vector<double> cost_;
+
+    // Candidate triangles of shortcut i are [tri_first_[i], tri_first_[i + 1]):
+    // rows (tri_left_[t] = A -> B, tri_right_[t] = B -> C). Base and opaque
+    // shortcuts (halves missing from the table) have none.
+    std::vector<uint32_t> tri_first_;
+    std::vector<uint32_t> tri_left_;
+    std::vector<uint32_t> tri_right_;
+    // Shortcut rows per hierarchy level; level 0 holds rows without triangles
+    std::vector<std::vector<uint32_t>> levels_;
+    // Base shortcuts by incoming edge
+    std::unordered_map<uint32_t, std::vector<uint32_t>> base_by_edge_;
+    // Rows changed by the last apply()
+    std::vector<uint32_t> changed_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Opt-in per-request profiling. Each stage of a request records wall time,
+// hardware counters (cycles, instructions, LLC misses, context switches,
+// via perf_event_open on the calling thread) and, in builds configured with
+// ROUTING_PROFILE_ALLOCATIONS, heap allocations made by the calling thread.
+// Counters that the kernel refuses to open (e.g. perf_event_paranoid,
+// containers) are reported as unavailable. Time spent waiting on locks is
+// not measured; it only shows up as wall time and context switches.
+
+struct ProfileSample {
+    uint64_t wall_us = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t llc_misses = 0;
+    uint64_t context_switches = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+
+    ProfileSample& operator+=(const ProfileSample& other);
+    nlohmann::json to_json() const;
+};
+
+// Allocations made by the calling thread since it started; always 0
+// unless allocation counting was compiled in
+uint64_t thread_allocation_count();
+uint64_t thread_allocated_bytes();
+bool allocation_counters_available();
+
+// True if hardware counters could be opened on this thread
+bool perf_counters_available();
+
+class RequestProfiler {
+public:
+    explicit RequestProfiler(bool enabled) : enabled_(enabled) {}
+
+    bool enabled() const { return enabled_; }
+
+    // Bracket one stage; stages must not nest
+    void begin(const char* stage);
+    void end();
+
+    const std::vector<std::pair<std::string, ProfileSample>>& stages() const { return stages_; }
+    ProfileSample total() const;
+    nlohmann::json to_json() const;
+
+private:
+    bool enabled_;
+    const char* current_ = nullptr;
+    ProfileSample start_;
+    std::vector<std::pair<std::string, ProfileSample>> stages_;
+};
+
+// Aggregates profiled requests: per-stage totals, maxima and a log2 wall-time
+// histogram, plus the slowest requests with their full breakdown.
+class ProfileAggregator {
+public:
+    void record(const RequestProfiler& profiler, const std::string& label);
+    nlohmann::json to_json() const;
+
+private:
+    static constexpr size_t HISTOGRAM_BUCKETS = 24; // 1us .. ~8s
+    static constexpr size_t SLOWEST_KEPT = 10;
+
+    struct StageStats {
+        uint64_t count = 0;
+        ProfileSample sum;
+        uint64_t max_wall_us = 0;
+        std::array<uint64_t, HISTOGRAM_BUCKETS> wall_histogram{};
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, StageStats>> stages_;
+    uint64_t requests_ = 0;
+    std::vector<std::pair<uint64_t, nlohmann::json>> slowest_; // (total wall us, profile)
+};
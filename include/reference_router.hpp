@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Plain Dijkstra over the base shortcuts of a shortcut table, used as
+// ground truth for the CH searches. Base shortcuts are the rows without a
+// via edge (incoming_edge -> outgoing_edge, cost); every other row is a
+// shortcut and is ignored, so the search sees the unhierarchized graph.
+class ReferenceRouter {
+public:
+    // Throws std::runtime_error if the table cannot be read
+    explicit ReferenceRouter(const std::string& shortcuts_path);
+
+    // Seeds are (edge id, offset). Returns the cheapest
+    // source offset + path cost + target offset, or infinity.
+    double query(const std::vector<std::pair<uint32_t, double>>& sources,
+                 const std::vector<std::pair<uint32_t, double>>& targets) const;
+
+    size_t edge_count() const { return ids_.size(); }
+    size_t arc_count() const { return head_.size(); }
+
+private:
+    std::unordered_map<uint32_t, uint32_t> index_; // edge id -> node
+    std::vector<uint32_t> ids_;                    // node -> edge id
+    // Arcs of node v are [first_[v], first_[v + 1])
+    std::vector<uint32_t> first_;
+    std::vector<uint32_t> head_;
+    std::vector<double> cost_;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+// Single-flight execution: while a computation for a key is in flight,
+// further calls with the same key wait for its result instead of
+// computing it again.
+class RequestCoalescer {
+public:
+    nlohmann::json run(const std::string& key, const std::function<nlohmann::json()>& compute);
+
+    nlohmann::json stats() const;
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_future<nlohmann::json>> in_flight_;
+    std::atomic<uint64_t> leaders_{0};   // Calls that computed
+    std::atomic<uint64_t> followers_{0}; // Calls served from another call's result
+};
@@ -5,12 +5,24 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
+#include <algorithm>
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/point.hpp>
 #include <boost/geometry/geometries/box.hpp>
 #include <boost/geometry/index/rtree.hpp>
 
 #include "shortcut_graph.hpp"
+#include "edge_reorder.hpp"
+#include "expansion_cache.hpp"
+#include "metric_customizer.hpp"
+#include "shared_dataset.hpp"
+#include "profiler.hpp"
 
 namespace bg = boost::geometry;
 namespace bgi = boost::geometry::index;
@@ -19,23 +31,100 @@ using Point = bg::model::point<double, 2, bg::cs::cartesian>; // Lon, Lat
 using Box = bg::model::box<Point>;
 using Value = std::pair<Box, uint32_t>; // Bounding box, Edge ID
 
+// Spatial index used to snap coordinates to edges
+enum class SpatialBackend {
+    RTree,     // Boost R-tree over edge bounding boxes
+    H3Buckets  // Fixed-resolution H3 cell -> contiguous edge list
+};
+
+// How much of a route compute_route builds; each level stops right after
+// the step it needs
+enum class RouteOutput {
+    Full,     // Unpacked path, GeoJSON geometry and debug info
+    Edges,    // Unpacked base-edge path, no geometry
+    Distance  // Search cost only, no unpacking
+};
+
 class RoutingEngine {
 public:
     RoutingEngine();
     ~RoutingEngine() = default;
 
+    // Edges bucketed by every H3 cell their geometry passes through.
+    // Entries of one cell are contiguous: cells[c] = [begin, end) into entries.
+    struct H3EdgeBuckets {
+        int res = 9;
+        double cell_edge_m = 0.0;
+        std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> cells;
+        std::vector<Value> entries;
+    };
+
+    // Span of one edge's polyline in Dataset::geometry_points, plus its
+    // haversine length computed at load time
+    using EdgeGeometry = SharedDatasetSegment::EdgeGeometry;
+
     struct Dataset {
         std::string name;
         bool loaded = false;
-        ShortcutGraph graph;
+        std::string shortcuts_path;
+        std::string edges_path;
+        // Graph and the cache of its shortcut -> base-edge spans, published
+        // together: weight updates that move via edges start a fresh cache
+        struct Metric {
+            std::shared_ptr<const ShortcutGraph> graph;
+            std::shared_ptr<ShortcutExpansionCache> expansion_cache;
+            // Highest length / cost among overridden edges (infinite for a
+            // zero cost); seed pruning is skipped while it exceeds the bound
+            double max_override_speed_mps = 0.0;
+        };
+        // Current metric. Weight updates publish a new one; queries take a
+        // snapshot at the start so they see one consistent metric.
+        std::atomic<std::shared_ptr<const Metric>> metric;
+        SpatialBackend spatial_backend = SpatialBackend::RTree;
         bgi::rtree< Value, bgi::quadratic<16> > rtree;
-        // Map from edge ID to geometry (WKT or sequence of points)
-        std::unordered_map<uint32_t, std::vector<std::pair<double, double>>> edge_geometries; 
+        H3EdgeBuckets h3_buckets;
+        // All edge polylines back to back as (lat, lon); edges index into it.
+        // Views owned_points, or the shared segment when there is one.
+        std::span<const std::pair<double, double>> geometry_points;
+        std::vector<std::pair<double, double>> owned_points;
+        std::unordered_map<uint32_t, EdgeGeometry> edge_geometries;
+        // Geometry and R-tree in shared memory; when set, owned_points,
+        // edge_geometries and rtree stay empty
+        std::unique_ptr<SharedDatasetSegment> shared;
+        // Built on the first weight update; metric_mutex serializes updates
+        std::unique_ptr<MetricCustomizer> customizer;
+        std::mutex metric_mutex;
+        // Set while /weights overrides are in effect; a reload would lose
+        // them, so such datasets are not evicted
+        std::atomic<bool> overridden{false};
+        // Bounding box of all edge geometry (x = lon, y = lat)
+        Box bounds;
+        // Estimated resident size: graph, spatial index, geometry, cache
+        // budget and, once built, the metric customizer
+        size_t memory_bytes = 0;
+        // Access tick for LRU eviction
+        std::atomic<uint64_t> last_used{0};
+        // Set when edges were renumbered at load: every internal structure
+        // uses the new ids and the API translates at the boundary
+        std::unique_ptr<EdgeOrdering> ordering;
+
+        const EdgeGeometry* find_geometry(uint32_t edge_id) const;
+        size_t edge_count() const { return shared ? shared->edge_count() : edge_geometries.size(); }
+        // Edge id as seen by API clients
+        uint32_t external_id(uint32_t id) const { return ordering ? ordering->to_original(id) : id; }
+    };
+
+    // Seeds removed before a default-mode search
+    struct CandidatePruning {
+        size_t sources_pruned = 0;
+        size_t targets_pruned = 0;
     };
 
     bool load_dataset(const std::string& dataset_name, const std::string& datasets_path,
                       const std::string& explicit_shortcuts_path = "",
-                      const std::string& explicit_edges_path = "");
+                      const std::string& explicit_edges_path = "",
+                      const std::string& spatial_index = "rtree",
+                      bool reorder_edges = false);
     bool unload_dataset(const std::string& dataset_name);
 
     nlohmann::json compute_route(
@@ -44,10 +133,54 @@ public:
         double end_lat, double end_lng,
         double search_radius = 1000.0,
         int max_candidates = 10,
-        const std::string& mode = "default"
+        const std::string& mode = "default",
+        bool profile = false, // Per-stage counters in response["profile"]
+        RouteOutput output = RouteOutput::Full
     );
     std::vector<std::string> get_loaded_datasets() const;
 
+    // Override base-edge costs and publish the customized metric.
+    // Overrides accumulate across calls unless reset is set.
+    nlohmann::json update_weights(
+        const std::string& dataset_name,
+        const std::vector<std::pair<uint32_t, double>>& overrides,
+        bool reset = false,
+        int threads = 4
+    );
+
+    // On-demand loading: datasets under datasets_path are loaded on first use,
+    // and least recently used datasets are evicted once the summed estimate
+    // exceeds budget_bytes (0 = unlimited). Bounding boxes of all datasets
+    // are scanned up front so routes can omit the dataset name.
+    void configure_lazy_loading(const std::string& datasets_path, bool enabled,
+                                size_t budget_bytes, const std::string& spatial_index = "rtree",
+                                bool reorder_edges = false);
+
+    // Name of the smallest known dataset covering both points (or the start
+    // point alone); empty if none does
+    std::string resolve_dataset(double start_lat, double start_lng,
+                                double end_lat, double end_lng) const;
+
+    size_t memory_used_bytes() const;
+    size_t memory_budget_bytes() const { return memory_budget_bytes_; }
+
+    // Budget for each dataset's shortcut expansion cache (applies to later loads)
+    void configure_expansion_cache(size_t budget_bytes, uint32_t pin_hits);
+    // Keep R-tree datasets' geometry and index in named shared-memory
+    // segments that other processes attach to (applies to later loads).
+    // Segments are removed when the last process detaches unless persistent,
+    // in which case they survive restarts until an explicit unload.
+    void configure_shared_memory(bool enabled, bool persistent = false);
+    nlohmann::json get_stats() const;
+    // Default-mode seed pruning: seeds that cannot beat the nearest pair are
+    // dropped. max_speed_mps must bound edge length / cost for every edge;
+    // 0 keeps only approach-cost pruning. Datasets whose weight overrides
+    // break the bound are searched unpruned.
+    void configure_candidate_pruning(bool enabled, double max_speed_mps);
+    nlohmann::json get_pruning_stats() const;
+    // Aggregate of all profiled compute_route calls
+    nlohmann::json get_profile_stats() const;
+
     std::vector<std::pair<uint32_t, double>> find_nearest_edges(
         const std::string& dataset_name,
         double lat, double lng,
@@ -55,16 +188,78 @@ public:
         int max_candidates = 5
     );
     
+    // Nearest edges for many points at once, results in input order.
+    // Points are (lat, lng). Small batches run on the calling thread; larger
+    // ones add up to threads - 1 helpers from an engine-wide allowance.
+    std::vector<std::vector<std::pair<uint32_t, double>>> find_nearest_edges_batch(
+        const std::string& dataset_name,
+        const std::vector<std::pair<double, double>>& points,
+        double radius = 1000.0,
+        int max_candidates = 5,
+        int threads = 4
+    );
+
     std::pair<uint32_t, double> find_nearest_edge(
         const std::string& dataset_name,
         double lat, double lng
     );
 
 private:
-    std::unordered_map<std::string, Dataset> datasets_;
+    std::unordered_map<std::string, std::shared_ptr<Dataset>> datasets_;
+    mutable std::shared_mutex datasets_mutex_;
+    mutable std::atomic<uint64_t> access_clock_{0};
+    ProfileAggregator profile_stats_;
+
+    // Where each known dataset lives and what area it covers
+    struct CatalogEntry {
+        std::string shortcuts_path;
+        std::string edges_path;
+        std::string spatial_index = "rtree";
+        bool reorder_edges = false;
+        // Found by the lazy-loading directory scan: loaded on first use and
+        // evictable under the memory budget
+        bool on_demand = false;
+        bool has_bounds = false;
+        Box bounds;
+    };
+    std::string datasets_path_;
+    bool lazy_loading_ = false;
+    size_t memory_budget_bytes_ = 0;
+    std::unordered_map<std::string, CatalogEntry> catalog_;
+    bgi::rtree< std::pair<Box, std::string>, bgi::quadratic<16> > catalog_index_;
+    mutable std::mutex catalog_mutex_;
+    // Loads in progress; concurrent requests wait on the same future
+    std::unordered_map<std::string, std::shared_future<std::shared_ptr<Dataset>>> pending_loads_;
+    std::mutex pending_mutex_;
+    bool shared_memory_ = false;
+    bool shared_memory_persistent_ = false;
+    bool prune_candidates_ = false;
+    double prune_max_speed_mps_ = 40.0;
+    std::atomic<uint64_t> pruned_queries_{0};
+    std::atomic<uint64_t> seeds_kept_{0};
+    std::atomic<uint64_t> seeds_pruned_{0};
+    // Helper threads batch lookups may still start, shared by all
+    // concurrent batches so they cannot oversubscribe the request threads
+    std::atomic<int> batch_helpers_free_{static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+    // Names the temporary tables weight updates load graphs from
+    std::atomic<uint64_t> weights_file_counter_{0};
+    size_t expansion_cache_bytes_ = 64u << 20;
+    uint32_t expansion_cache_pin_hits_ = 32;
 
     // Helper methods
     // Helper methods moved to public
+    std::shared_ptr<Dataset> get_dataset(const std::string& dataset_name) const;
+    // load_dataset, returning the new dataset (nullptr on failure)
+    std::shared_ptr<Dataset> load_dataset_internal(const std::string& dataset_name,
+                                                   const std::string& datasets_path,
+                                                   const std::string& explicit_shortcuts_path,
+                                                   const std::string& explicit_edges_path,
+                                                   const std::string& spatial_index,
+                                                   bool reorder_edges, bool on_demand);
+    // get_dataset, loading the dataset first if lazy loading is enabled
+    std::shared_ptr<Dataset> acquire_dataset(const std::string& dataset_name);
+    void register_catalog_entry(const std::string& dataset_name, const CatalogEntry& entry);
+    void evict_to_budget(const std::string& keep);
 
     // Internal helper
     std::vector<std::pair<uint32_t, double>> find_nearest_edges_internal(
@@ -74,6 +269,20 @@ private:
         int max_candidates
     );
 
+    std::vector<std::pair<uint32_t, double>> find_nearest_edges_h3(
+        const Dataset& dataset,
+        double lat, double lng,
+        double radius,
+        int max_candidates
+    );
+
+    // Unpack a CH path into base edges through the metric's expansion cache
+    bool expand_path_cached(
+        const Dataset::Metric& metric,
+        const std::vector<uint32_t>& path,
+        std::vector<uint32_t>& base_edges
+    );
+
     nlohmann::json run_contraction_hierarchies(
         const Dataset& dataset,
         const std::vector<std::pair<double, double>>& start_candidates,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "routing_engine.hpp"
+#include "request_coalescer.hpp"
 #include <crow.h>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -17,19 +18,38 @@ public:
 private:
     // HTTP handlers
     crow::response handle_health_check();
-    crow::response handle_route(const crow::request& req);
+    crow::response handle_stats();
+    // default_output is used when the body has no "return" field
+    crow::response handle_route(const crow::request& req, const std::string& default_output = "full");
     crow::response handle_load_dataset(const crow::request& req);
     crow::response handle_unload_dataset(const crow::request& req);
+    crow::response handle_weights(const crow::request& req);
+    crow::response handle_nearest_edges_batch(const crow::request& req);
 
     // Configuration
     struct Config {
         int port = 8080;
         std::string host = "0.0.0.0";
         int thread_count = 4;
+        size_t max_batch_points = 10000; // Larger /nearest_edges/batch requests are rejected
         std::string datasets_path = "../routing-pipeline/data";
+        std::string spatial_index = "rtree"; // Default snapping backend: "rtree" or "h3"
+        bool reorder_edges = false;          // Renumber edges along a Hilbert curve at load
+        bool shared_memory = false;          // Share geometry and R-tree between server processes
+        bool shared_memory_persistent = false; // Keep segments across restarts until /unload_dataset
+        size_t expansion_cache_bytes = 64u << 20; // Per dataset
+        uint32_t expansion_cache_pin_hits = 32;
+        bool lazy_loading = false;       // Load datasets on first request
+        size_t memory_budget_bytes = 0;  // 0 = unlimited
+        bool coalesce_requests = true;   // Share results of identical in-flight routes
+        int coalesce_precision = 5;      // Coordinate decimals in the coalescing key
+        bool prune_candidates = false;      // Drop dominated default-mode seeds
+        double prune_max_speed_mps = 40.0;  // Speed bound for the network lower bound (0 = off)
+        double profile_sample_percent = 0.0; // Share of routes profiled without asking
     } config_;
 
     // Components
     std::unique_ptr<RoutingEngine> routing_engine_;
+    RequestCoalescer route_coalescer_;
     crow::SimpleApp app_;
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/geometries/point.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/vector.hpp>
+#include <boost/interprocess/managed_shared_memory.hpp>
+
+// Edge geometry and R-tree of one dataset in a named POSIX shared-memory
+// segment. Containers use the segment allocator (offset pointers), so any
+// process can map the segment at any address and query it in place. A
+// restarted server attaches to the segment instead of parsing edges.csv
+// and building the index again.
+//
+// Every process mapping a segment holds a shared flock on
+// <tmp>/<name>.users, which the kernel drops when the process exits or
+// crashes. The one that detaches last (the only one that can then take the
+// lock exclusively) removes the segment, so segments of deleted or changed
+// datasets do not pile up in /dev/shm. A segment whose last user crashed is
+// removed by the next attach to that name or by remove_unused().
+//
+// Persistent segments are not removed on detach, so a restarted server
+// finds them again; only unlink() (an explicit dataset unload) or a
+// create() replacing them removes them. A segment built from different
+// source files (by size and mtime) is never attached. Create, attach and
+// detach of one name are serialized by a second file lock.
+class SharedDatasetSegment {
+public:
+    using Point = boost::geometry::model::point<double, 2, boost::geometry::cs::cartesian>; // Lon, Lat
+    using Box = boost::geometry::model::box<Point>;
+    using Value = std::pair<Box, uint32_t>;
+
+    // Span of one edge's polyline in the geometry points, plus its
+    // haversine length computed at load time
+    struct EdgeGeometry {
+        uint32_t offset = 0;
+        uint32_t count = 0;
+        double length_m = 0.0;
+    };
+    // Edge slots are ordered by id for lookup
+    struct EdgeSlot {
+        uint32_t id = 0;
+        EdgeGeometry geometry;
+    };
+
+    // Identity of the files a segment was built from
+    struct SourceStamp {
+        uint64_t shortcuts_size = 0;
+        int64_t shortcuts_mtime = 0;
+        uint64_t edges_size = 0;
+        int64_t edges_mtime = 0;
+        bool reordered = false;
+        bool operator==(const SourceStamp&) const = default;
+    };
+    static SourceStamp stamp(const std::string& shortcuts_path, const std::string& edges_path, bool reordered);
+
+    // Segment name for a dataset ("routing_<name>", unsafe characters replaced)
+    static std::string segment_name(const std::string& dataset_name);
+
+    // Attach to a complete segment built from the same sources; nullptr if
+    // none. A stale segment no process maps any more is removed.
+    // Throws std::runtime_error if the lock files cannot be used.
+    static std::unique_ptr<SharedDatasetSegment> attach(const std::string& name, const SourceStamp& stamp,
+                                                        bool persistent = false);
+
+    // Build a segment (replacing a stale one) and attach to it.
+    // edges must be sorted by id; entries are bulk-loaded into the R-tree.
+    // Throws boost::interprocess::interprocess_exception, or
+    // std::runtime_error if the lock files cannot be used.
+    static std::unique_ptr<SharedDatasetSegment> create(const std::string& name, const SourceStamp& stamp,
+                                                        const std::vector<std::pair<double, double>>& points,
+                                                        const std::vector<EdgeSlot>& edges,
+                                                        const std::vector<Value>& entries,
+                                                        bool persistent = false);
+
+    // Remove every segment in the temp directory's lock files that no
+    // process maps, left behind by crashed servers; returns how many
+    static size_t remove_unused();
+
+    // Unmaps; also removes the segment if it is not persistent and no other
+    // process maps it
+    ~SharedDatasetSegment();
+    SharedDatasetSegment(const SharedDatasetSegment&) = delete;
+    SharedDatasetSegment& operator=(const SharedDatasetSegment&) = delete;
+
+    std::span<const std::pair<double, double>> points() const {
+        if (points_->empty()) return {};
+        return {&points_->front(), points_->size()};
+    }
+    const EdgeSlot* find_edge(uint32_t id) const;
+    size_t edge_count() const { return edges_->size(); }
+    size_t rtree_size() const { return rtree_->size(); }
+    Box bounds() const { return rtree_->bounds(); }
+    size_t size_bytes() const { return segment_.get_size(); }
+    const std::string& name() const { return name_; }
+    // True if this process built the segment rather than attaching to it
+    bool created() const { return created_; }
+    // Remove the segment's name so no process attaches to it again, unless
+    // the name now belongs to a newer segment. Existing mappings stay valid.
+    bool unlink() const;
+
+    // Visit the R-tree values matching predicates, nearest first for a
+    // nearest predicate, until fn returns false
+    template <typename Predicates, typename Fn>
+    void query_until(const Predicates& predicates, Fn fn) const {
+        for (auto it = rtree_->qbegin(predicates); it != rtree_->qend(); ++it) {
+            if (!fn(*it)) break;
+        }
+    }
+
+private:
+    using SegmentManager = boost::interprocess::managed_shared_memory::segment_manager;
+    template <typename T>
+    using Allocator = boost::interprocess::allocator<T, SegmentManager>;
+    using PointVector = boost::interprocess::vector<std::pair<double, double>, Allocator<std::pair<double, double>>>;
+    using EdgeVector = boost::interprocess::vector<EdgeSlot, Allocator<EdgeSlot>>;
+    using RTree = boost::geometry::index::rtree<Value, boost::geometry::index::quadratic<16>,
+                                               boost::geometry::index::indexable<Value>,
+                                               boost::geometry::index::equal_to<Value>,
+                                               Allocator<Value>>;
+    struct Header;
+
+    SharedDatasetSegment(std::string name, boost::interprocess::managed_shared_memory segment, bool created,
+                         int users_fd, bool persistent);
+
+    std::string name_;
+    boost::interprocess::managed_shared_memory segment_;
+    Header* header_ = nullptr;
+    PointVector* points_ = nullptr;
+    EdgeVector* edges_ = nullptr;
+    RTree* rtree_ = nullptr;
+    bool created_ = false;
+    // Holds the shared lock on the users file
+    int users_fd_ = -1;
+    bool persistent_ = false;
+};
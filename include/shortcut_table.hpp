@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace arrow {
+class Table;
+}
+
+// The columns of a shortcut table (incoming_edge, outgoing_edge, cost,
+// via_edge) as plain vectors in file row order. Id columns may be any
+// integer width and costs double or float.
+struct ShortcutTable {
+    static constexpr int64_t NO_VIA = -1;
+
+    std::vector<int64_t> from;
+    std::vector<int64_t> to;
+    std::vector<int64_t> via; // NO_VIA where null
+    std::vector<double> cost;
+
+    size_t size() const { return cost.size(); }
+    // A base shortcut is one turn (from -> to) and costs the traversal of from
+    bool is_base(size_t row) const { return via[row] < 0 || via[row] == from[row] || via[row] == to[row]; }
+};
+
+// Throws std::runtime_error on a missing column or unsupported column type
+ShortcutTable read_shortcut_columns(const arrow::Table& table);
+
+// Reads only the four columns from a parquet file; throws on unreadable input
+ShortcutTable read_shortcut_table(const std::string& path);
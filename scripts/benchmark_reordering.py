@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Benchmark Hilbert edge reordering against the original edge ids.
+
+Loads the dataset twice under two aliases (reorder_edges off and on), runs the
+same random profiled /route queries on both and reports latency, per-stage
+cycles and LLC misses, and whether both return the same routes.
+"""
+import argparse
+import random
+import statistics
+import time
+
+import requests
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--url", default="http://localhost:8080")
+parser.add_argument("--data-dir", required=True, help="Dataset directory with shortcuts.parquet and edges.csv")
+parser.add_argument("--lat", type=float, required=True, help="Center latitude of the query area")
+parser.add_argument("--lon", type=float, required=True, help="Center longitude of the query area")
+parser.add_argument("--spread", type=float, default=0.05, help="Query spread in degrees")
+parser.add_argument("--queries", type=int, default=500)
+parser.add_argument("--mode", default="default")
+args = parser.parse_args()
+
+VARIANTS = {"original": False, "hilbert": True}
+STAGES = ["find_nearest", "search", "expand", "geojson"]
+
+for name, reorder in VARIANTS.items():
+    t0 = time.time()
+    r = requests.post(f"{args.url}/load_dataset", json={
+        "dataset": f"bench_{name}",
+        "shortcuts_path": f"{args.data_dir}/shortcuts.parquet",
+        "edges_path": f"{args.data_dir}/edges.csv",
+        "reorder_edges": reorder,
+    })
+    print(f"Loaded bench_{name} in {time.time() - t0:.1f}s: {r.json()}")
+
+random.seed(42)
+pairs = [((args.lat + random.uniform(-args.spread, args.spread), args.lon + random.uniform(-args.spread, args.spread)),
+          (args.lat + random.uniform(-args.spread, args.spread), args.lon + random.uniform(-args.spread, args.spread)))
+         for _ in range(args.queries)]
+
+latencies = {v: [] for v in VARIANTS}
+stage_sums = {v: {s: {"wall_us": 0, "cycles": 0, "llc_misses": 0} for s in STAGES} for v in VARIANTS}
+routes = {v: [] for v in VARIANTS}
+perf_counters = True
+session = requests.Session()
+# Alternate variants per query so both see the same cache and load conditions
+for (slat, slon), (elat, elon) in pairs:
+    for variant in VARIANTS:
+        t0 = time.perf_counter()
+        r = session.post(f"{args.url}/route", json={
+            "dataset": f"bench_{variant}", "start_lat": slat, "start_lng": slon,
+            "end_lat": elat, "end_lng": elon, "mode": args.mode, "profile": True,
+        }).json()
+        latencies[variant].append((time.perf_counter() - t0) * 1000.0)
+        if not r.get("success"):
+            routes[variant].append(None)
+            continue
+        routes[variant].append((round(r["route"]["distance"], 6), tuple(r["route"]["path"])))
+        profile = r.get("profile", {})
+        perf_counters = perf_counters and profile.get("perf_counters", False)
+        for stage in STAGES:
+            sample = profile.get("stages", {}).get(stage, {})
+            for key in stage_sums[variant][stage]:
+                stage_sums[variant][stage][key] += sample.get(key, 0)
+
+print("=" * 72)
+for variant in VARIANTS:
+    lat_ms = sorted(latencies[variant])
+    print(f"{variant:9s} mean {statistics.mean(lat_ms):.3f} ms  "
+          f"p50 {lat_ms[len(lat_ms) // 2]:.3f} ms  p99 {lat_ms[int(len(lat_ms) * 0.99)]:.3f} ms")
+
+print("-" * 72)
+print(f"{'stage':13s} {'metric':11s} {'original':>14s} {'hilbert':>14s} {'change':>9s}")
+metrics = ["wall_us", "cycles", "llc_misses"] if perf_counters else ["wall_us"]
+for stage in STAGES:
+    for metric in metrics:
+        a = stage_sums["original"][stage][metric] / len(pairs)
+        b = stage_sums["hilbert"][stage][metric] / len(pairs)
+        change = f"{(b - a) / a * 100:+.1f}%" if a else "-"
+        print(f"{stage:13s} {metric:11s} {a:14.1f} {b:14.1f} {change:>9s}")
+if not perf_counters:
+    print("(perf counters unavailable; check /proc/sys/kernel/perf_event_paranoid)")
+
+same = sum(1 for a, b in zip(routes["original"], routes["hilbert"]) if a == b)
+print("-" * 72)
+print(f"Identical routes: {same}/{len(pairs)}")
+
+for variant in VARIANTS:
+    requests.post(f"{args.url}/unload_dataset", json={"dataset": f"bench_{variant}"})
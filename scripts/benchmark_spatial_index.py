@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Benchmark H3 bucket snapping against the R-tree on the same dataset.
+
+Loads the dataset twice under two aliases (one per backend), fires the same
+random /nearest_edges queries at both and reports latency and agreement.
+"""
+import argparse
+import random
+import statistics
+import time
+
+import requests
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--url", default="http://localhost:8080")
+parser.add_argument("--data-dir", required=True, help="Dataset directory with shortcuts.parquet and edges.csv")
+parser.add_argument("--lat", type=float, required=True, help="Center latitude of the query area")
+parser.add_argument("--lon", type=float, required=True, help="Center longitude of the query area")
+parser.add_argument("--spread", type=float, default=0.02, help="Query spread in degrees")
+parser.add_argument("--queries", type=int, default=2000)
+parser.add_argument("--radius", type=float, default=500.0)
+parser.add_argument("--max-candidates", type=int, default=10)
+args = parser.parse_args()
+
+BACKENDS = ["rtree", "h3"]
+
+for backend in BACKENDS:
+    t0 = time.time()
+    r = requests.post(f"{args.url}/load_dataset", json={
+        "dataset": f"bench_{backend}",
+        "shortcuts_path": f"{args.data_dir}/shortcuts.parquet",
+        "edges_path": f"{args.data_dir}/edges.csv",
+        "spatial_index": backend,
+    })
+    print(f"Loaded bench_{backend} in {time.time() - t0:.1f}s: {r.json()}")
+
+random.seed(42)
+points = [(args.lat + random.uniform(-args.spread, args.spread),
+           args.lon + random.uniform(-args.spread, args.spread)) for _ in range(args.queries)]
+
+latencies = {b: [] for b in BACKENDS}
+results = {b: [] for b in BACKENDS}
+session = requests.Session()
+for lat, lon in points:
+    for backend in BACKENDS:
+        t0 = time.perf_counter()
+        r = session.get(f"{args.url}/nearest_edges", params={
+            "dataset": f"bench_{backend}", "lat": lat, "lon": lon,
+            "radius": args.radius, "max_candidates": args.max_candidates,
+        })
+        latencies[backend].append((time.perf_counter() - t0) * 1000.0)
+        results[backend].append([e["id"] for e in r.json().get("edges", [])])
+
+print("=" * 60)
+for backend in BACKENDS:
+    lat_ms = sorted(latencies[backend])
+    print(f"{backend:6s} mean {statistics.mean(lat_ms):.3f} ms  "
+          f"p50 {lat_ms[len(lat_ms) // 2]:.3f} ms  p99 {lat_ms[int(len(lat_ms) * 0.99)]:.3f} ms")
+
+same_nearest = sum(1 for a, b in zip(results["rtree"], results["h3"]) if a[:1] == b[:1])
+same_set = sum(1 for a, b in zip(results["rtree"], results["h3"]) if set(a) == set(b))
+print(f"Same nearest edge: {same_nearest}/{len(points)}")
+print(f"Same candidate set: {same_set}/{len(points)}")
+
+for backend in BACKENDS:
+    requests.post(f"{args.url}/unload_dataset", json={"dataset": f"bench_{backend}"})
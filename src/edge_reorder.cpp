@@ -0,0 +1,381 @@
+#include "edge_reorder.hpp"
+#include "edges_csv.hpp"
+#include "geo_kernels.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bump when the renumbering or the cache layout changes
+constexpr int CACHE_VERSION = 1;
+
+const char* const ID_COLUMNS[] = {"incoming_edge", "outgoing_edge", "via_edge"};
+
+// Replace field `index` of a CSV line, honouring quotes
+std::string replace_csv_field(const std::string& line, size_t index, const std::string& value) {
+    size_t field = 0;
+    size_t begin = 0;
+    bool in_quotes = false;
+    for (size_t i = 0; i <= line.size(); ++i) {
+        if (i == line.size() || (line[i] == ',' && !in_quotes)) {
+            if (field == index) return line.substr(0, begin) + value + line.substr(i);
+            ++field;
+            begin = i + 1;
+        } else if (line[i] == '"') {
+            in_quotes = !in_quotes;
+        }
+    }
+    return line;
+}
+
+template <typename ArrayT>
+void collect_chunk_ids(const arrow::ChunkedArray& column, std::vector<uint32_t>& ids) {
+    for (const auto& chunk : column.chunks()) {
+        auto values = std::static_pointer_cast<ArrayT>(chunk);
+        for (int64_t i = 0; i < chunk->length(); ++i) {
+            if (chunk->IsNull(i)) continue;
+            auto v = values->Value(i);
+            if constexpr (std::is_signed_v<decltype(v)>) {
+                if (v < 0) continue;
+            }
+            ids.push_back(static_cast<uint32_t>(v));
+        }
+    }
+}
+
+// Negative sentinels and nulls are kept; every other id is mapped
+template <typename ArrayT, typename BuilderT>
+std::shared_ptr<arrow::ChunkedArray> remap_chunk_ids(const arrow::ChunkedArray& column,
+                                                     const EdgeOrdering& ordering) {
+    arrow::ArrayVector chunks;
+    for (const auto& chunk : column.chunks()) {
+        auto values = std::static_pointer_cast<ArrayT>(chunk);
+        BuilderT builder;
+        PARQUET_THROW_NOT_OK(builder.Reserve(chunk->length()));
+        for (int64_t i = 0; i < chunk->length(); ++i) {
+            if (chunk->IsNull(i)) {
+                PARQUET_THROW_NOT_OK(builder.AppendNull());
+                continue;
+            }
+            auto v = values->Value(i);
+            if constexpr (std::is_signed_v<decltype(v)>) {
+                if (v < 0) {
+                    PARQUET_THROW_NOT_OK(builder.Append(v));
+                    continue;
+                }
+            }
+            PARQUET_THROW_NOT_OK(builder.Append(ordering.to_internal(static_cast<uint32_t>(v))));
+        }
+        std::shared_ptr<arrow::Array> remapped;
+        PARQUET_THROW_NOT_OK(builder.Finish(&remapped));
+        chunks.push_back(remapped);
+    }
+    return std::make_shared<arrow::ChunkedArray>(chunks, column.type());
+}
+
+void collect_ids(const arrow::ChunkedArray& column, const std::string& name, std::vector<uint32_t>& ids) {
+    switch (column.type()->id()) {
+        case arrow::Type::INT32: return collect_chunk_ids<arrow::Int32Array>(column, ids);
+        case arrow::Type::INT64: return collect_chunk_ids<arrow::Int64Array>(column, ids);
+        case arrow::Type::UINT32: return collect_chunk_ids<arrow::UInt32Array>(column, ids);
+        case arrow::Type::UINT64: return collect_chunk_ids<arrow::UInt64Array>(column, ids);
+        default:
+            throw std::runtime_error("Unsupported type for column " + name + ": " + column.type()->ToString());
+    }
+}
+
+std::shared_ptr<arrow::ChunkedArray> remap_ids(const arrow::ChunkedArray& column, const std::string& name,
+                                               const EdgeOrdering& ordering) {
+    switch (column.type()->id()) {
+        case arrow::Type::INT32: return remap_chunk_ids<arrow::Int32Array, arrow::Int32Builder>(column, ordering);
+        case arrow::Type::INT64: return remap_chunk_ids<arrow::Int64Array, arrow::Int64Builder>(column, ordering);
+        case arrow::Type::UINT32: return remap_chunk_ids<arrow::UInt32Array, arrow::UInt32Builder>(column, ordering);
+        case arrow::Type::UINT64: return remap_chunk_ids<arrow::UInt64Array, arrow::UInt64Builder>(column, ordering);
+        default:
+            throw std::runtime_error("Unsupported type for column " + name + ": " + column.type()->ToString());
+    }
+}
+
+} // namespace
+
+EdgeOrdering reorder_edges_hilbert(const std::string& shortcuts_in, const std::string& edges_in,
+                                   const std::string& shortcuts_out, const std::string& edges_out) {
+    std::ifstream in(edges_in);
+    std::string header;
+    if (!in || !std::getline(in, header)) throw std::runtime_error("Cannot read " + edges_in);
+
+    auto headers = parse_csv_line(header);
+    int id_idx = -1;
+    int geom_idx = -1;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (headers[i] == "id") id_idx = i;
+        else if (headers[i] == "geometry") geom_idx = i;
+    }
+    if (id_idx == -1 || geom_idx == -1) throw std::runtime_error("Missing id or geometry column in " + edges_in);
+
+    // One row per edge: original id, bounding-box center (lat, lon)
+    struct Row {
+        uint32_t id;
+        bool has_center;
+        double lat, lon;
+        uint64_t key;
+    };
+    std::vector<std::string> lines;
+    std::vector<Row> rows;
+    std::unordered_set<uint32_t> seen;
+    double min_lat = 90.0, max_lat = -90.0, min_lon = 180.0, max_lon = -180.0;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        auto columns = parse_csv_line(line);
+        if (static_cast<int>(columns.size()) <= std::max(id_idx, geom_idx)) continue;
+        uint32_t id;
+        try {
+            id = std::stoul(columns[id_idx]);
+        } catch (...) {
+            continue;
+        }
+        if (!seen.insert(id).second) continue;
+
+        Row row{id, false, 0.0, 0.0, UINT64_MAX};
+        auto points = parse_wkt_linestring(columns[geom_idx]);
+        if (!points.empty()) {
+            double lo_lat = points[0].first, hi_lat = points[0].first;
+            double lo_lon = points[0].second, hi_lon = points[0].second;
+            for (const auto& p : points) {
+                lo_lat = std::min(lo_lat, p.first);
+                hi_lat = std::max(hi_lat, p.first);
+                lo_lon = std::min(lo_lon, p.second);
+                hi_lon = std::max(hi_lon, p.second);
+            }
+            row.has_center = true;
+            row.lat = (lo_lat + hi_lat) / 2.0;
+            row.lon = (lo_lon + hi_lon) / 2.0;
+            min_lat = std::min(min_lat, row.lat);
+            max_lat = std::max(max_lat, row.lat);
+            min_lon = std::min(min_lon, row.lon);
+            max_lon = std::max(max_lon, row.lon);
+        }
+        rows.push_back(row);
+        lines.push_back(std::move(line));
+    }
+
+    double span_lat = std::max(max_lat - min_lat, 1e-9);
+    double span_lon = std::max(max_lon - min_lon, 1e-9);
+    auto to_grid = [](double t) {
+        return static_cast<uint32_t>(std::clamp(t, 0.0, 1.0) * 65535.0);
+    };
+    for (auto& row : rows) {
+        if (!row.has_center) continue;
+        row.key = hilbert_index(to_grid((row.lon - min_lon) / span_lon),
+                                to_grid((row.lat - min_lat) / span_lat));
+    }
+
+    std::vector<uint32_t> order(rows.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        if (rows[a].key != rows[b].key) return rows[a].key < rows[b].key;
+        return rows[a].id < rows[b].id;
+    });
+
+    EdgeOrdering ordering;
+    ordering.original_ids.reserve(rows.size());
+    ordering.internal_ids.reserve(rows.size());
+    for (uint32_t r : order) {
+        ordering.internal_ids.emplace(rows[r].id, static_cast<uint32_t>(ordering.original_ids.size()));
+        ordering.original_ids.push_back(rows[r].id);
+    }
+
+    // Shortcut table: edges without a geometry row go after, by original id
+    std::shared_ptr<arrow::Table> table;
+    {
+        PARQUET_ASSIGN_OR_THROW(auto infile, arrow::io::ReadableFile::Open(shortcuts_in));
+        std::unique_ptr<parquet::arrow::FileReader> reader;
+        PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+        PARQUET_THROW_NOT_OK(reader->ReadTable(&table));
+    }
+    std::vector<uint32_t> extra;
+    for (const char* name : ID_COLUMNS) {
+        auto column = table->GetColumnByName(name);
+        if (!column) throw std::runtime_error(std::string("Missing column in shortcuts table: ") + name);
+        collect_ids(*column, name, extra);
+    }
+    std::sort(extra.begin(), extra.end());
+    extra.erase(std::unique(extra.begin(), extra.end()), extra.end());
+    for (uint32_t id : extra) {
+        if (ordering.internal_ids.emplace(id, static_cast<uint32_t>(ordering.original_ids.size())).second) {
+            ordering.original_ids.push_back(id);
+        }
+    }
+
+    for (const char* name : ID_COLUMNS) {
+        int index = table->schema()->GetFieldIndex(name);
+        auto remapped = remap_ids(*table->column(index), name, ordering);
+        PARQUET_ASSIGN_OR_THROW(table, table->SetColumn(index, table->schema()->field(index), remapped));
+    }
+    PARQUET_ASSIGN_OR_THROW(auto outfile, arrow::io::FileOutputStream::Open(shortcuts_out));
+    PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(*table, arrow::default_memory_pool(), outfile, 1 << 20));
+    PARQUET_THROW_NOT_OK(outfile->Close());
+
+    std::ofstream out(edges_out);
+    if (!out) throw std::runtime_error("Cannot write " + edges_out);
+    out << header << '\n';
+    for (uint32_t r : order) {
+        out << replace_csv_field(lines[r], id_idx, std::to_string(ordering.internal_ids.at(rows[r].id))) << '\n';
+    }
+    if (!out) throw std::runtime_error("Cannot write " + edges_out);
+    return ordering;
+}
+
+namespace {
+
+// Identity of the inputs a cache was built from
+std::string input_stamp(const std::string& shortcuts_in, const std::string& edges_in) {
+    std::ostringstream out;
+    out << "version " << CACHE_VERSION << '\n';
+    for (const auto& path : {shortcuts_in, edges_in}) {
+        out << fs::absolute(path).string() << ' ' << fs::file_size(path) << ' '
+            << fs::last_write_time(path).time_since_epoch().count() << '\n';
+    }
+    return out.str();
+}
+
+std::string read_text(const fs::path& path) {
+    std::ifstream in(path);
+    std::ostringstream out;
+    out << in.rdbuf();
+    return out.str();
+}
+
+void write_text(const fs::path& path, const std::string& text) {
+    std::ofstream out(path);
+    out << text;
+    if (!out) throw std::runtime_error("Cannot write " + path.string());
+}
+
+// Internal -> original ids as raw uint32 values
+void write_id_table(const fs::path& path, const EdgeOrdering& ordering) {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(ordering.original_ids.data()),
+              ordering.original_ids.size() * sizeof(uint32_t));
+    if (!out) throw std::runtime_error("Cannot write " + path.string());
+}
+
+EdgeOrdering read_id_table(const fs::path& path) {
+    EdgeOrdering ordering;
+    ordering.original_ids.resize(fs::file_size(path) / sizeof(uint32_t));
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char*>(ordering.original_ids.data()), ordering.original_ids.size() * sizeof(uint32_t));
+    if (!in) throw std::runtime_error("Cannot read " + path.string());
+    ordering.internal_ids.reserve(ordering.original_ids.size());
+    for (uint32_t i = 0; i < ordering.original_ids.size(); ++i) ordering.internal_ids.emplace(ordering.original_ids[i], i);
+    return ordering;
+}
+
+// Remove temporaries left by rebuilds whose process no longer exists
+void remove_stale_temporaries(const fs::path& dir) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        auto pos = name.rfind(".tmp");
+        if (pos == std::string::npos) continue;
+        pid_t pid = 0;
+        try {
+            pid = std::stoi(name.substr(pos + 4));
+        } catch (...) {
+            continue;
+        }
+        if (pid != getpid() && kill(pid, 0) != 0 && errno == ESRCH) fs::remove(entry.path(), ec);
+    }
+}
+
+} // namespace
+
+std::vector<std::string> reorder_cache_dirs(const std::string& shortcuts_in, const std::string& edges_in) {
+    fs::path dataset_dir = fs::path(shortcuts_in).parent_path();
+    // FNV-1a, so datasets whose directories share a name get separate caches
+    uint64_t hash = 1469598103934665603ull;
+    for (const auto& path : {shortcuts_in, edges_in}) {
+        for (unsigned char c : fs::absolute(path).string()) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+    }
+    std::ostringstream name;
+    name << "routing_hilbert_" << dataset_dir.filename().string() << '_' << std::hex << hash;
+    return {(dataset_dir / "hilbert").string(), (fs::temp_directory_path() / name.str()).string()};
+}
+
+std::optional<ReorderedDataset> find_reordered_cached(const std::string& shortcuts_in, const std::string& edges_in,
+                                                     const std::string& cache_dir) {
+    fs::path dir(cache_dir);
+    fs::path stamp_path = dir / "stamp";
+    std::error_code ec;
+    if (!fs::exists(stamp_path, ec) || read_text(stamp_path) != input_stamp(shortcuts_in, edges_in)) {
+        return std::nullopt;
+    }
+    ReorderedDataset result;
+    result.shortcuts_path = (dir / "shortcuts.parquet").string();
+    result.edges_path = (dir / "edges.csv").string();
+    result.ordering = read_id_table(dir / "ids.bin");
+    return result;
+}
+
+ReorderedDataset reorder_edges_hilbert_cached(const std::string& shortcuts_in, const std::string& edges_in,
+                                              const std::string& cache_dir) {
+    if (auto cached = find_reordered_cached(shortcuts_in, edges_in, cache_dir)) return std::move(*cached);
+
+    fs::path dir(cache_dir);
+    fs::path ids_path = dir / "ids.bin";
+    fs::path stamp_path = dir / "stamp";
+    ReorderedDataset result;
+    result.shortcuts_path = (dir / "shortcuts.parquet").string();
+    result.edges_path = (dir / "edges.csv").string();
+
+    std::string stamp = input_stamp(shortcuts_in, edges_in);
+    std::error_code ec;
+
+    fs::create_directories(dir, ec);
+    if (ec) throw std::runtime_error("Cannot create " + cache_dir + ": " + ec.message());
+    remove_stale_temporaries(dir);
+    // Invalidate first: the stamp only ever describes complete copies
+    fs::remove(stamp_path, ec);
+
+    std::string suffix = ".tmp" + std::to_string(getpid());
+    std::vector<std::string> temporaries = {result.shortcuts_path + suffix, result.edges_path + suffix,
+                                            ids_path.string() + suffix, stamp_path.string() + suffix};
+    try {
+        result.ordering = reorder_edges_hilbert(shortcuts_in, edges_in, temporaries[0], temporaries[1]);
+        write_id_table(temporaries[2], result.ordering);
+        write_text(temporaries[3], stamp);
+        fs::rename(temporaries[0], result.shortcuts_path);
+        fs::rename(temporaries[1], result.edges_path);
+        fs::rename(temporaries[2], ids_path);
+        fs::rename(temporaries[3], stamp_path);
+    } catch (...) {
+        for (const auto& path : temporaries) fs::remove(path, ec);
+        throw;
+    }
+    result.rebuilt = true;
+    return result;
+}
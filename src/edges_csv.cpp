@@ -0,0 +1,49 @@
+#include "edges_csv.hpp"
+
+#include <sstream>
+
+// Helper to parse WKT LINESTRING
+std::vector<std::pair<double, double>> parse_wkt_linestring(const std::string& wkt) {
+    std::vector<std::pair<double, double>> points;
+    // Simple regex to find coordinate pairs
+    // WKT format: LINESTRING (lon lat, lon lat, ...)
+    try {
+        size_t start = wkt.find('(');
+        size_t end = wkt.find(')');
+        if (start == std::string::npos || end == std::string::npos) return points;
+        
+        std::string coords_str = wkt.substr(start + 1, end - start - 1);
+        std::stringstream ss(coords_str);
+        std::string segment;
+        
+        while (std::getline(ss, segment, ',')) {
+            std::stringstream point_ss(segment);
+            double lon, lat;
+            if (point_ss >> lon >> lat) {
+                points.push_back({lat, lon}); // Store as Lat, Lon for API consistency
+            }
+        }
+    } catch (...) {
+        // Ignore parsing errors for robustness
+    }
+    return points;
+}
+
+// Minimal CSV parser handling quotes
+std::vector<std::string> parse_csv_line(const std::string& line) {
+    std::vector<std::string> result;
+    bool in_quotes = false;
+    std::string current;
+    for (char c : line) {
+        if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (c == ',' && !in_quotes) {
+            result.push_back(current);
+            current.clear();
+        } else {
+            current.push_back(c);
+        }
+    }
+    result.push_back(current);
+    return result;
+}
@@ -0,0 +1,92 @@
+#include "expansion_cache.hpp"
+
+#include <algorithm>
+
+ShortcutExpansionCache::ShortcutExpansionCache(size_t budget_bytes, uint32_t pin_hits, size_t shards)
+    : budget_bytes_(budget_bytes),
+      pin_hits_(pin_hits),
+      shard_count_(std::max<size_t>(shards, 1)),
+      shards_(std::make_unique<Shard[]>(shard_count_)) {
+    shard_budget_bytes_ = budget_bytes_ / shard_count_;
+}
+
+bool ShortcutExpansionCache::append(uint32_t from, uint32_t to, std::vector<uint32_t>& out, size_t skip) {
+    uint64_t k = key(from, to);
+    Shard& shard = shard_of(k);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(k);
+    if (it == shard.entries.end()) {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    Entry& entry = it->second;
+    ++entry.hits;
+
+    if (!entry.pinned) {
+        size_t bytes = entry_bytes(entry);
+        if (entry.hits >= pin_hits_ && shard.pinned_bytes + bytes <= shard_budget_bytes_ / 2) {
+            shard.lru.erase(entry.lru_it);
+            entry.pinned = true;
+            shard.pinned_bytes += bytes;
+        } else if (entry.lru_it != shard.lru.begin()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru_it);
+        }
+    }
+
+    if (skip < entry.base_edges.size()) {
+        out.insert(out.end(), entry.base_edges.begin() + skip, entry.base_edges.end());
+    }
+    return true;
+}
+
+void ShortcutExpansionCache::insert(uint32_t from, uint32_t to, const std::vector<uint32_t>& base_edges) {
+    uint64_t k = key(from, to);
+    Shard& shard = shard_of(k);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto [it, inserted] = shard.entries.try_emplace(k);
+    if (!inserted) return; // Another thread filled it first
+
+    Entry& entry = it->second;
+    entry.base_edges = base_edges;
+    shard.lru.push_front(k);
+    entry.lru_it = shard.lru.begin();
+    shard.bytes += entry_bytes(entry);
+    evict_to_budget(shard);
+}
+
+void ShortcutExpansionCache::evict_to_budget(Shard& shard) {
+    while (shard.bytes > shard_budget_bytes_ && !shard.lru.empty()) {
+        auto it = shard.entries.find(shard.lru.back());
+        shard.lru.pop_back();
+        shard.bytes -= entry_bytes(it->second);
+        shard.entries.erase(it);
+        ++shard.evictions;
+    }
+}
+
+nlohmann::json ShortcutExpansionCache::stats() const {
+    size_t entries = 0, bytes = 0, pinned_bytes = 0;
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    for (size_t i = 0; i < shard_count_; ++i) {
+        const Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        entries += shard.entries.size();
+        bytes += shard.bytes;
+        pinned_bytes += shard.pinned_bytes;
+        hits += shard.hits;
+        misses += shard.misses;
+        evictions += shard.evictions;
+    }
+    uint64_t lookups = hits + misses;
+    return {
+        {"entries", entries},
+        {"bytes", bytes},
+        {"pinned_bytes", pinned_bytes},
+        {"budget_bytes", budget_bytes_},
+        {"hits", hits},
+        {"misses", misses},
+        {"evictions", evictions},
+        {"hit_rate", lookups ? static_cast<double>(hits) / lookups : 0.0}
+    };
+}
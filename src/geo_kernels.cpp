@@ -0,0 +1,214 @@
+#include "geo_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEO_KERNELS_X86 1
+#endif
+
+static_assert(sizeof(std::pair<double, double>) == 2 * sizeof(double),
+              "Polyline kernels read points as interleaved lat/lon doubles");
+
+namespace {
+
+constexpr double METERS_PER_DEG = 111320.0;
+constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+// Squared distance from the origin to segment (ax, ay)-(bx, by)
+inline double origin_segment_dist2(double ax, double ay, double bx, double by) {
+    double dx = bx - ax;
+    double dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0.0 ? std::clamp(-(ax * dx + ay * dy) / len2, 0.0, 1.0) : 0.0;
+    double cx = ax + t * dx;
+    double cy = ay + t * dy;
+    return cx * cx + cy * cy;
+}
+
+// Segments of a batch of polylines, projected to meters around the query
+// point (which becomes the origin), with the polyline each belongs to
+struct SegmentBatch {
+    std::vector<double> ax, ay, bx, by, dist2;
+    std::vector<uint32_t> owner;
+
+    void clear() {
+        ax.clear();
+        ay.clear();
+        bx.clear();
+        by.clear();
+        owner.clear();
+    }
+    void push(double x0, double y0, double x1, double y1, uint32_t polyline) {
+        ax.push_back(x0);
+        ay.push_back(y0);
+        bx.push_back(x1);
+        by.push_back(y1);
+        owner.push_back(polyline);
+    }
+};
+
+// A single point becomes one zero-length segment
+void pack_segments(double lat, double lon, const PolylineRef* polylines, size_t n, SegmentBatch& batch) {
+    const double kx = METERS_PER_DEG * std::cos(lat * DEG_TO_RAD);
+    batch.clear();
+    for (size_t p = 0; p < n; ++p) {
+        const auto* points = polylines[p].points;
+        size_t count = polylines[p].count;
+        if (count == 0) continue;
+        double px = (points[0].second - lon) * kx;
+        double py = (points[0].first - lat) * METERS_PER_DEG;
+        if (count == 1) batch.push(px, py, px, py, static_cast<uint32_t>(p));
+        for (size_t i = 1; i < count; ++i) {
+            double qx = (points[i].second - lon) * kx;
+            double qy = (points[i].first - lat) * METERS_PER_DEG;
+            batch.push(px, py, qx, qy, static_cast<uint32_t>(p));
+            px = qx;
+            py = qy;
+        }
+    }
+    batch.dist2.resize(batch.owner.size());
+}
+
+void segment_dist2_scalar(SegmentBatch& batch, size_t begin) {
+    for (size_t i = begin; i < batch.owner.size(); ++i) {
+        batch.dist2[i] = origin_segment_dist2(batch.ax[i], batch.ay[i], batch.bx[i], batch.by[i]);
+    }
+}
+
+#ifdef GEO_KERNELS_X86
+// Four segments per iteration, the tail in the scalar loop
+__attribute__((target("avx2,fma")))
+void segment_dist2_avx2(SegmentBatch& batch) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const size_t n = batch.owner.size();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d ax = _mm256_loadu_pd(&batch.ax[i]);
+        __m256d ay = _mm256_loadu_pd(&batch.ay[i]);
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&batch.bx[i]), ax);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&batch.by[i]), ay);
+        __m256d len2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+        __m256d dot = _mm256_fmadd_pd(ax, dx, _mm256_mul_pd(ay, dy));
+        // t = clamp(-dot / len2, 0, 1); zero-length segments give t = 0
+        __m256d t = _mm256_div_pd(_mm256_sub_pd(zero, dot), len2);
+        t = _mm256_and_pd(t, _mm256_cmp_pd(len2, zero, _CMP_GT_OQ));
+        t = _mm256_min_pd(_mm256_max_pd(t, zero), one);
+        __m256d cx = _mm256_fmadd_pd(t, dx, ax);
+        __m256d cy = _mm256_fmadd_pd(t, dy, ay);
+        _mm256_storeu_pd(&batch.dist2[i], _mm256_fmadd_pd(cx, cx, _mm256_mul_pd(cy, cy)));
+    }
+    // GCC does not insert this for target-attribute functions; dirty upper
+    // halves would slow every later SSE instruction in the process
+    _mm256_zeroupper();
+    segment_dist2_scalar(batch, i);
+}
+#endif
+
+void reduce_segments(const SegmentBatch& batch, size_t n, double* out) {
+    std::fill(out, out + n, std::numeric_limits<double>::max());
+    for (size_t i = 0; i < batch.owner.size(); ++i) {
+        double& best = out[batch.owner[i]];
+        best = std::min(best, batch.dist2[i]);
+    }
+    for (size_t p = 0; p < n; ++p) {
+        if (out[p] != std::numeric_limits<double>::max()) out[p] = std::sqrt(out[p]);
+    }
+}
+
+bool detect_avx2() {
+#ifdef GEO_KERNELS_X86
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+double haversine_m(double lat1, double lon1, double lat2, double lon2) {
+    constexpr double R = 6371000.0;
+    double dLat = (lat2 - lat1) * DEG_TO_RAD;
+    double dLon = (lon2 - lon1) * DEG_TO_RAD;
+    lat1 = lat1 * DEG_TO_RAD;
+    lat2 = lat2 * DEG_TO_RAD;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::sin(dLon / 2) * std::sin(dLon / 2) * std::cos(lat1) * std::cos(lat2);
+    double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+    return R * c;
+}
+
+double polyline_length_m(const std::pair<double, double>* points, size_t count) {
+    double total = 0.0;
+    for (size_t i = 1; i < count; ++i) {
+        total += haversine_m(points[i - 1].first, points[i - 1].second,
+                             points[i].first, points[i].second);
+    }
+    return total;
+}
+
+double point_polyline_distance_m(double lat, double lon,
+                                 const std::pair<double, double>* points, size_t count) {
+    if (count == 0) return std::numeric_limits<double>::max();
+    const double kx = METERS_PER_DEG * std::cos(lat * DEG_TO_RAD);
+    double px = (points[0].second - lon) * kx;
+    double py = (points[0].first - lat) * METERS_PER_DEG;
+    double best2 = px * px + py * py;
+    for (size_t i = 1; i < count; ++i) {
+        double qx = (points[i].second - lon) * kx;
+        double qy = (points[i].first - lat) * METERS_PER_DEG;
+        best2 = std::min(best2, origin_segment_dist2(px, py, qx, qy));
+        px = qx;
+        py = qy;
+    }
+    return std::sqrt(best2);
+}
+
+void point_polylines_distance_m(double lat, double lon, const PolylineRef* polylines, size_t n, double* out) {
+    thread_local SegmentBatch batch;
+    pack_segments(lat, lon, polylines, n, batch);
+#ifdef GEO_KERNELS_X86
+    if (geo_kernels_use_avx2()) {
+        segment_dist2_avx2(batch);
+        reduce_segments(batch, n, out);
+        return;
+    }
+#endif
+    segment_dist2_scalar(batch, 0);
+    reduce_segments(batch, n, out);
+}
+
+void point_polylines_distance_m_scalar(double lat, double lon, const PolylineRef* polylines, size_t n,
+                                       double* out) {
+    for (size_t p = 0; p < n; ++p) {
+        out[p] = point_polyline_distance_m(lat, lon, polylines[p].points, polylines[p].count);
+    }
+}
+
+bool geo_kernels_use_avx2() {
+    static const bool use_avx2 = detect_avx2();
+    return use_avx2;
+}
+
+// Position of (x, y) on a Hilbert curve filling a 2^16 x 2^16 grid
+uint64_t hilbert_index(uint32_t x, uint32_t y) {
+    constexpr uint32_t N = 1u << 16;
+    uint64_t d = 0;
+    for (uint32_t s = N / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = N - 1 - x;
+                y = N - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
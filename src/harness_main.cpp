@@ -0,0 +1,391 @@
+// Differential correctness and latency harness for the routing modes.
+//
+// For every dataset, runs the same origin-destination pairs through the
+// one_to_one and default searches and through a plain Dijkstra over the
+// base shortcuts, in parallel, then reports cost mismatches and per-mode
+// latency percentiles. Exits with status 1 if any mode disagrees with the
+// reference, so it can gate releases of search changes.
+
+#include "edges_csv.hpp"
+#include "reference_router.hpp"
+#include "routing_engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The engine turns approach meters into seed offsets at this speed
+constexpr double ASSUMED_SPEED_MPS = 13.89;
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+struct Options {
+    std::string datasets_path = "../routing-pipeline/data";
+    std::vector<std::string> datasets;
+    std::string pairs_file;
+    size_t pairs = 2000;
+    uint64_t seed = 42;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    double radius = 1000.0;
+    int max_candidates = 10;
+    double tolerance = 1e-6;
+    std::string spatial_index = "rtree";
+    bool reorder_edges = false;
+    bool reference = true;
+    bool verbose = false;
+    size_t show = 10;
+    std::string json_path;
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " --dataset NAME [--dataset NAME ...] [options]\n"
+              << "  --datasets-path DIR     Directory with one subdirectory per dataset\n"
+              << "  --pairs N               Random OD pairs per dataset (default 2000)\n"
+              << "  --pairs-file CSV        Use start_lat,start_lng,end_lat,end_lng rows instead\n"
+              << "  --seed N                Random seed (default 42)\n"
+              << "  --threads N             Worker threads (default: all cores)\n"
+              << "  --radius M              Snapping radius in meters (default 1000)\n"
+              << "  --max-candidates N      Default-mode candidates per end (default 10)\n"
+              << "  --tolerance T           Relative cost tolerance (default 1e-6)\n"
+              << "  --spatial-index NAME    rtree or h3 (default rtree)\n"
+              << "  --reorder-edges         Load with Hilbert edge reordering\n"
+              << "  --no-reference          Skip the Dijkstra reference (latency only)\n"
+              << "  --show N                Mismatches to print per dataset (default 10)\n"
+              << "  --json PATH             Also write the report as JSON\n"
+              << "  --verbose               Keep the engine's log output\n";
+}
+
+Options parse_args(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--dataset") options.datasets.push_back(value());
+        else if (arg == "--datasets-path") options.datasets_path = value();
+        else if (arg == "--pairs") options.pairs = std::stoul(value());
+        else if (arg == "--pairs-file") options.pairs_file = value();
+        else if (arg == "--seed") options.seed = std::stoull(value());
+        else if (arg == "--threads") options.threads = std::max(1, std::stoi(value()));
+        else if (arg == "--radius") options.radius = std::stod(value());
+        else if (arg == "--max-candidates") options.max_candidates = std::stoi(value());
+        else if (arg == "--tolerance") options.tolerance = std::stod(value());
+        else if (arg == "--spatial-index") options.spatial_index = value();
+        else if (arg == "--reorder-edges") options.reorder_edges = true;
+        else if (arg == "--no-reference") options.reference = false;
+        else if (arg == "--show") options.show = std::stoul(value());
+        else if (arg == "--json") options.json_path = value();
+        else if (arg == "--verbose") options.verbose = true;
+        else throw std::runtime_error("Unknown argument: " + arg);
+    }
+    if (options.datasets.empty()) throw std::runtime_error("At least one --dataset is required");
+    return options;
+}
+
+struct OdPair {
+    double start_lat, start_lng, end_lat, end_lng;
+};
+
+std::vector<OdPair> read_pairs(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) throw std::runtime_error("Cannot read " + path);
+
+    auto headers = parse_csv_line(line);
+    int idx[4] = {-1, -1, -1, -1};
+    const char* names[4] = {"start_lat", "start_lng", "end_lat", "end_lng"};
+    for (size_t i = 0; i < headers.size(); ++i) {
+        for (int k = 0; k < 4; ++k) {
+            if (headers[i] == names[k]) idx[k] = static_cast<int>(i);
+        }
+    }
+    if (*std::min_element(idx, idx + 4) < 0) {
+        throw std::runtime_error(path + " needs start_lat,start_lng,end_lat,end_lng columns");
+    }
+
+    std::vector<OdPair> pairs;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        auto columns = parse_csv_line(line);
+        if (static_cast<int>(columns.size()) <= *std::max_element(idx, idx + 4)) continue;
+        pairs.push_back({std::stod(columns[idx[0]]), std::stod(columns[idx[1]]),
+                         std::stod(columns[idx[2]]), std::stod(columns[idx[3]])});
+    }
+    return pairs;
+}
+
+// Endpoints are random polyline vertices jittered by up to ~50 m, so they
+// land near the road network rather than anywhere in the bounding box
+std::vector<OdPair> random_pairs(const std::string& edges_path, size_t count, uint64_t seed) {
+    std::ifstream file(edges_path);
+    std::string line;
+    if (!file || !std::getline(file, line)) throw std::runtime_error("Cannot read " + edges_path);
+
+    auto headers = parse_csv_line(line);
+    auto geom_it = std::find(headers.begin(), headers.end(), "geometry");
+    if (geom_it == headers.end()) throw std::runtime_error("Missing geometry column in " + edges_path);
+    size_t geom_idx = geom_it - headers.begin();
+
+    std::vector<std::pair<double, double>> vertices;
+    while (std::getline(file, line)) {
+        auto columns = parse_csv_line(line);
+        if (columns.size() <= geom_idx) continue;
+        auto points = parse_wkt_linestring(columns[geom_idx]);
+        vertices.insert(vertices.end(), points.begin(), points.end());
+    }
+    if (vertices.empty()) throw std::runtime_error("No geometry in " + edges_path);
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, vertices.size() - 1);
+    std::uniform_real_distribution<double> jitter(-0.0004, 0.0004);
+    std::vector<OdPair> pairs(count);
+    for (auto& pair : pairs) {
+        const auto& a = vertices[pick(rng)];
+        const auto& b = vertices[pick(rng)];
+        pair = {a.first + jitter(rng), a.second + jitter(rng), b.first + jitter(rng), b.second + jitter(rng)};
+    }
+    return pairs;
+}
+
+// Discards everything written to it, for silencing the engine's logging
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+struct PairResult {
+    bool snapped = false;
+    double one_to_one = INF; // INF when no route
+    double multi = INF;
+    double reference_single = INF;
+    double reference_multi = INF;
+    double one_to_one_us = 0.0;
+    double multi_us = 0.0;
+    double reference_us = 0.0;
+};
+
+bool same_cost(double got, double expected, double tolerance) {
+    if (std::isinf(got) || std::isinf(expected)) return std::isinf(got) && std::isinf(expected);
+    return std::abs(got - expected) <= tolerance * std::max(1.0, std::abs(expected));
+}
+
+nlohmann::json latency_summary(std::vector<double> us) {
+    if (us.empty()) return nlohmann::json::object();
+    std::sort(us.begin(), us.end());
+    auto pct = [&](double p) { return us[std::min(us.size() - 1, static_cast<size_t>(p * us.size()))]; };
+    double sum = 0.0;
+    for (double v : us) sum += v;
+    return {
+        {"count", us.size()},
+        {"mean_us", sum / us.size()},
+        {"p50_us", pct(0.50)},
+        {"p90_us", pct(0.90)},
+        {"p99_us", pct(0.99)},
+        {"max_us", us.back()}
+    };
+}
+
+double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+double route_cost(const nlohmann::json& response) {
+    if (!response.value("success", false)) return INF;
+    return response["route"]["distance"].get<double>();
+}
+
+nlohmann::json run_dataset(RoutingEngine& engine, const Options& options, const std::string& name,
+                           std::ostream& report) {
+    std::string dir = options.datasets_path + "/" + name;
+    auto load_start = std::chrono::steady_clock::now();
+    if (!engine.load_dataset(name, options.datasets_path, "", "", options.spatial_index, options.reorder_edges)) {
+        throw std::runtime_error("Failed to load dataset " + name);
+    }
+    std::unique_ptr<ReferenceRouter> reference;
+    if (options.reference) reference = std::make_unique<ReferenceRouter>(dir + "/shortcuts.parquet");
+    double load_s = elapsed_us(load_start) / 1e6;
+
+    auto pairs = options.pairs_file.empty() ? random_pairs(dir + "/edges.csv", options.pairs, options.seed)
+                                            : read_pairs(options.pairs_file);
+    std::vector<PairResult> results(pairs.size());
+
+    // Workers pull pairs one at a time so slow queries do not stall a chunk
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < pairs.size(); i = next++) {
+            const auto& od = pairs[i];
+            auto& r = results[i];
+
+            // Same snapping as each mode: one_to_one takes a single candidate
+            auto start_one = engine.find_nearest_edges(name, od.start_lat, od.start_lng, options.radius, 1);
+            auto end_one = engine.find_nearest_edges(name, od.end_lat, od.end_lng, options.radius, 1);
+            auto starts = engine.find_nearest_edges(name, od.start_lat, od.start_lng, options.radius,
+                                                    options.max_candidates);
+            auto ends = engine.find_nearest_edges(name, od.end_lat, od.end_lng, options.radius,
+                                                  options.max_candidates);
+            r.snapped = !start_one.empty() && !end_one.empty() && !starts.empty() && !ends.empty();
+            if (!r.snapped) continue;
+
+            auto t = std::chrono::steady_clock::now();
+            r.one_to_one = route_cost(engine.compute_route(name, od.start_lat, od.start_lng, od.end_lat, od.end_lng,
+                                                           options.radius, 1, "one_to_one", false,
+                                                           RouteOutput::Distance));
+            r.one_to_one_us = elapsed_us(t);
+
+            t = std::chrono::steady_clock::now();
+            r.multi = route_cost(engine.compute_route(name, od.start_lat, od.start_lng, od.end_lat, od.end_lng,
+                                                      options.radius, options.max_candidates, "default", false,
+                                                      RouteOutput::Distance));
+            r.multi_us = elapsed_us(t);
+
+            if (!reference) continue;
+            auto seeds = [](const std::vector<std::pair<uint32_t, double>>& candidates) {
+                std::vector<std::pair<uint32_t, double>> out;
+                for (const auto& [edge, meters] : candidates) out.push_back({edge, meters / ASSUMED_SPEED_MPS});
+                return out;
+            };
+            r.reference_single = reference->query(seeds(start_one), seeds(end_one));
+            t = std::chrono::steady_clock::now();
+            r.reference_multi = reference->query(seeds(starts), seeds(ends));
+            r.reference_us = elapsed_us(t);
+        }
+    };
+    auto run_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int w = 0; w < options.threads; ++w) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+    double run_s = elapsed_us(run_start) / 1e6;
+
+    // Tally
+    size_t snapped = 0;
+    size_t checked[2] = {0, 0}, mismatched[2] = {0, 0}, no_route[2] = {0, 0};
+    std::vector<double> latency[3];
+    nlohmann::json mismatches = nlohmann::json::array();
+    const char* modes[2] = {"one_to_one", "default"};
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        if (!r.snapped) continue;
+        ++snapped;
+        latency[0].push_back(r.one_to_one_us);
+        latency[1].push_back(r.multi_us);
+        if (reference) latency[2].push_back(r.reference_us);
+
+        double got[2] = {r.one_to_one, r.multi};
+        double expected[2] = {r.reference_single, r.reference_multi};
+        for (int m = 0; m < 2; ++m) {
+            if (std::isinf(got[m])) ++no_route[m];
+            if (!reference) continue;
+            ++checked[m];
+            if (same_cost(got[m], expected[m], options.tolerance)) continue;
+            ++mismatched[m];
+            if (mismatches.size() < options.show) {
+                const auto& od = pairs[i];
+                auto cost = [](double c) { return std::isinf(c) ? nlohmann::json(nullptr) : nlohmann::json(c); };
+                mismatches.push_back({
+                    {"pair", i}, {"mode", modes[m]},
+                    {"start", {od.start_lat, od.start_lng}}, {"end", {od.end_lat, od.end_lng}},
+                    {"cost", cost(got[m])}, {"reference", cost(expected[m])}
+                });
+            }
+        }
+    }
+
+    nlohmann::json result = {
+        {"dataset", name},
+        {"pairs", pairs.size()},
+        {"snapped", snapped},
+        {"threads", options.threads},
+        {"load_s", load_s},
+        {"run_s", run_s},
+        {"mismatches", mismatches}
+    };
+    for (int m = 0; m < 2; ++m) {
+        result["modes"][modes[m]] = {
+            {"checked", checked[m]},
+            {"mismatches", mismatched[m]},
+            {"no_route", no_route[m]},
+            {"latency", latency_summary(latency[m])}
+        };
+    }
+    if (reference) result["modes"]["reference"] = {{"latency", latency_summary(latency[2])}};
+
+    report << "== " << name << ": " << pairs.size() << " pairs, " << snapped << " snapped, "
+           << options.threads << " threads, load " << std::fixed << std::setprecision(1) << load_s
+           << " s, run " << run_s << " s\n";
+    report << std::left << std::setw(12) << "mode" << std::right << std::setw(9) << "checked"
+           << std::setw(10) << "mismatch" << std::setw(10) << "no-route" << std::setw(10) << "mean"
+           << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+           << std::setw(10) << "max" << "  (us)\n";
+    for (const char* mode : {"one_to_one", "default", "reference"}) {
+        if (!result["modes"].contains(mode)) continue;
+        const auto& stats = result["modes"][mode];
+        const auto& lat = stats["latency"];
+        report << std::left << std::setw(12) << mode << std::right
+               << std::setw(9) << stats.value("checked", size_t{0})
+               << std::setw(10) << stats.value("mismatches", size_t{0})
+               << std::setw(10) << stats.value("no_route", size_t{0});
+        for (const char* key : {"mean_us", "p50_us", "p90_us", "p99_us", "max_us"}) {
+            report << std::setw(10) << std::setprecision(0) << lat.value(key, 0.0);
+        }
+        report << "\n";
+    }
+    for (const auto& m : mismatches) report << "  mismatch " << m.dump() << "\n";
+    report << std::flush;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        options = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // The engine logs every query to stdout; keep the report readable
+    std::ostream report(std::cout.rdbuf());
+    NullBuffer null_buffer;
+    if (!options.verbose) std::cout.rdbuf(&null_buffer);
+
+    nlohmann::json summary = nlohmann::json::array();
+    size_t total_mismatches = 0;
+    try {
+        RoutingEngine engine;
+        for (const auto& name : options.datasets) {
+            auto result = run_dataset(engine, options, name, report);
+            total_mismatches += result["modes"]["one_to_one"]["mismatches"].get<size_t>() +
+                                result["modes"]["default"]["mismatches"].get<size_t>();
+            summary.push_back(result);
+            engine.unload_dataset(name);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    if (!options.json_path.empty()) {
+        std::ofstream out(options.json_path);
+        out << summary.dump(2) << std::endl;
+    }
+    report << (total_mismatches == 0 ? "OK: all modes match the reference" :
+               "FAIL: " + std::to_string(total_mismatches) + " mismatches") << std::endl;
+    return total_mismatches == 0 ? 0 : 1;
+}
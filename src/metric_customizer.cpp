@@ -0,0 +1,346 @@
+#include "metric_customizer.hpp"
+#include "shortcut_table.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+
+namespace {
+
+// Run fn(begin, end) over [0, n) split across threads
+template <typename Fn>
+void parallel_for(size_t n, int threads, Fn fn) {
+    constexpr size_t MIN_CHUNK = 4096;
+    size_t workers = std::min<size_t>(std::max(threads, 1), (n + MIN_CHUNK - 1) / MIN_CHUNK);
+    if (workers <= 1) {
+        fn(size_t{0}, n);
+        return;
+    }
+    std::vector<std::thread> pool;
+    size_t chunk = (n + workers - 1) / workers;
+    for (size_t w = 0; w < workers; ++w) {
+        size_t begin = w * chunk;
+        size_t end = std::min(n, begin + chunk);
+        if (begin < end) pool.emplace_back(fn, begin, end);
+    }
+    for (auto& t : pool) t.join();
+}
+
+template <typename T>
+size_t vector_bytes(const std::vector<T>& v) {
+    return v.capacity() * sizeof(T);
+}
+
+// Costs of rows [offset, offset + length) in the column's float type
+template <typename BuilderT, typename ValueT>
+std::shared_ptr<arrow::ChunkedArray> cost_column(const std::vector<double>& cost, size_t offset, int64_t length) {
+    BuilderT builder;
+    PARQUET_THROW_NOT_OK(builder.Reserve(length));
+    for (int64_t i = 0; i < length; ++i) builder.UnsafeAppend(static_cast<ValueT>(cost[offset + i]));
+    std::shared_ptr<arrow::Array> array;
+    PARQUET_THROW_NOT_OK(builder.Finish(&array));
+    return std::make_shared<arrow::ChunkedArray>(array);
+}
+
+// Via column of rows starting at offset: rows whose via edge moved get the
+// new one, every other row keeps its stored value or null
+template <typename ArrayT, typename BuilderT>
+std::shared_ptr<arrow::ChunkedArray> via_column(const arrow::ChunkedArray& column, const std::vector<int64_t>& via,
+                                                const std::vector<int64_t>& original_via, size_t offset) {
+    arrow::ArrayVector chunks;
+    size_t row = offset;
+    for (const auto& chunk : column.chunks()) {
+        auto values = std::static_pointer_cast<ArrayT>(chunk);
+        using ValueT = std::decay_t<decltype(values->Value(0))>;
+        BuilderT builder;
+        PARQUET_THROW_NOT_OK(builder.Reserve(chunk->length()));
+        for (int64_t i = 0; i < chunk->length(); ++i, ++row) {
+            if (via[row] != original_via[row]) {
+                PARQUET_THROW_NOT_OK(builder.Append(static_cast<ValueT>(via[row])));
+            } else if (chunk->IsNull(i)) {
+                PARQUET_THROW_NOT_OK(builder.AppendNull());
+            } else {
+                PARQUET_THROW_NOT_OK(builder.Append(values->Value(i)));
+            }
+        }
+        std::shared_ptr<arrow::Array> merged;
+        PARQUET_THROW_NOT_OK(builder.Finish(&merged));
+        chunks.push_back(merged);
+    }
+    return std::make_shared<arrow::ChunkedArray>(chunks, column.type());
+}
+
+} // namespace
+
+MetricCustomizer::MetricCustomizer(const std::string& shortcuts_path) : shortcuts_path_(shortcuts_path) {
+    auto table = read_shortcut_table(shortcuts_path);
+    const size_t n = table.size();
+
+    // Dense node per edge id, and the rows leaving each node
+    std::unordered_map<int64_t, uint32_t> node_of;
+    node_of.reserve(n);
+    auto node = [&node_of](int64_t edge) {
+        return node_of.emplace(edge, static_cast<uint32_t>(node_of.size())).first->second;
+    };
+    std::vector<uint32_t> tail(n), head(n);
+    for (size_t i = 0; i < n; ++i) {
+        tail[i] = node(table.from[i]);
+        head[i] = node(table.to[i]);
+    }
+    const size_t nodes = node_of.size();
+
+    // Hierarchy height: 0 for edges no shortcut touching them goes through,
+    // else 1 + the height of the highest via below them. Longest path over
+    // node -> via links by iterative DFS (0 = new, 1 = open, 2 = done); a
+    // link closing a cycle is ignored.
+    std::vector<std::vector<uint32_t>> below(nodes);
+    for (size_t i = 0; i < n; ++i) {
+        if (table.is_base(i)) continue;
+        uint32_t via = node(table.via[i]);
+        if (node_of.size() > below.size()) below.resize(node_of.size());
+        below[tail[i]].push_back(via);
+        below[head[i]].push_back(via);
+    }
+    std::vector<int32_t> height(below.size(), 0);
+    std::vector<uint8_t> state(below.size(), 0);
+    std::vector<std::pair<uint32_t, size_t>> stack; // (node, next link)
+    for (uint32_t root = 0; root < below.size(); ++root) {
+        if (state[root] != 0) continue;
+        state[root] = 1;
+        stack.push_back({root, 0});
+        while (!stack.empty()) {
+            auto& [v, next] = stack.back();
+            if (next < below[v].size()) {
+                uint32_t w = below[v][next++];
+                if (state[w] == 0) {
+                    state[w] = 1;
+                    stack.push_back({w, 0});
+                }
+                continue;
+            }
+            for (uint32_t w : below[v]) {
+                if (state[w] == 2) height[v] = std::max(height[v], height[w] + 1);
+            }
+            state[v] = 2;
+            stack.pop_back();
+        }
+    }
+    std::vector<std::vector<uint32_t>>().swap(below);
+
+    // Rows by tail node, lowest head first, for the triangle scan below
+    std::vector<uint32_t> out_first(nodes + 1, 0);
+    for (size_t i = 0; i < n; ++i) ++out_first[tail[i] + 1];
+    for (size_t v = 0; v < nodes; ++v) out_first[v + 1] += out_first[v];
+    std::vector<uint32_t> out_rows(n);
+    {
+        std::vector<uint32_t> next(out_first.begin(), out_first.end() - 1);
+        for (size_t i = 0; i < n; ++i) out_rows[next[tail[i]]++] = static_cast<uint32_t>(i);
+    }
+    for (size_t v = 0; v < nodes; ++v) {
+        std::sort(out_rows.begin() + out_first[v], out_rows.begin() + out_first[v + 1],
+                  [&](uint32_t a, uint32_t b) { return height[head[a]] < height[head[b]]; });
+    }
+
+    std::unordered_map<uint64_t, uint32_t> row_of;
+    row_of.reserve(n);
+    auto key = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+    for (size_t i = 0; i < n; ++i) row_of.emplace(key(tail[i], head[i]), static_cast<uint32_t>(i));
+
+    // Triangles A -> B -> C of each shortcut A -> C with B below A and C.
+    // Both halves then sit on a lower level than the shortcut, whose level
+    // is the height of its lower end.
+    std::vector<int32_t> level(n, 0);
+    tri_first_.assign(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        tri_first_[i] = static_cast<uint32_t>(tri_left_.size());
+        if (table.is_base(i)) {
+            base_by_edge_[static_cast<uint32_t>(table.from[i])].push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+        int32_t top = std::min(height[tail[i]], height[head[i]]);
+        for (uint32_t k = out_first[tail[i]]; k < out_first[tail[i] + 1]; ++k) {
+            uint32_t left = out_rows[k];
+            if (height[head[left]] >= top) break;
+            auto right = row_of.find(key(head[left], head[i]));
+            if (right == row_of.end()) continue;
+            tri_left_.push_back(left);
+            tri_right_.push_back(right->second);
+        }
+        // Shortcuts without a triangle keep their stored cost
+        if (tri_left_.size() > tri_first_[i]) level[i] = top;
+    }
+    tri_first_[n] = static_cast<uint32_t>(tri_left_.size());
+    tri_left_.shrink_to_fit();
+    tri_right_.shrink_to_fit();
+
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<size_t>(level[i]) >= levels_.size()) levels_.resize(level[i] + 1);
+        levels_[level[i]].push_back(static_cast<uint32_t>(i));
+    }
+
+    from_ = std::move(table.from);
+    to_ = std::move(table.to);
+    original_via_ = std::move(table.via);
+    via_ = original_via_;
+    original_cost_ = std::move(table.cost);
+    cost_ = original_cost_;
+}
+
+MetricCustomizer::UpdateStats MetricCustomizer::apply(
+    const std::vector<std::pair<uint32_t, double>>& overrides, bool reset, int threads) {
+    UpdateStats stats;
+    stats.overrides = overrides.size();
+    stats.levels = levels_.size();
+    changed_.clear();
+
+    std::vector<uint8_t> dirty(cost_.size(), 0);
+    bool any_dirty = false;
+    if (reset) {
+        for (size_t i = 0; i < cost_.size(); ++i) {
+            if (cost_[i] == original_cost_[i] && via_[i] == original_via_[i]) continue;
+            if (cost_[i] != original_cost_[i]) ++stats.shortcuts_updated;
+            if (via_[i] != original_via_[i]) ++stats.vias_changed;
+            cost_[i] = original_cost_[i];
+            via_[i] = original_via_[i];
+            dirty[i] = 1;
+            any_dirty = true;
+        }
+    }
+
+    for (const auto& [edge_id, edge_cost] : overrides) {
+        auto it = base_by_edge_.find(edge_id);
+        if (it == base_by_edge_.end()) continue;
+        for (uint32_t i : it->second) {
+            ++stats.base_updated;
+            if (cost_[i] == edge_cost) continue;
+            cost_[i] = edge_cost;
+            dirty[i] = 1;
+            any_dirty = true;
+        }
+    }
+    if (!any_dirty) return stats;
+
+    // Halves always sit on lower levels, so each level only reads finished costs.
+    // Ties keep the current via edge.
+    for (size_t lvl = 1; lvl < levels_.size(); ++lvl) {
+        const auto& shortcuts = levels_[lvl];
+        std::atomic<size_t> updated{0};
+        std::atomic<size_t> moved{0};
+        parallel_for(shortcuts.size(), threads, [&](size_t begin, size_t end) {
+            size_t local_updated = 0;
+            size_t local_moved = 0;
+            for (size_t k = begin; k < end; ++k) {
+                uint32_t i = shortcuts[k];
+                bool stale = false;
+                for (uint32_t t = tri_first_[i]; t < tri_first_[i + 1] && !stale; ++t) {
+                    stale = dirty[tri_left_[t]] || dirty[tri_right_[t]];
+                }
+                if (!stale) continue;
+
+                double best = std::numeric_limits<double>::infinity();
+                int64_t best_via = via_[i];
+                for (uint32_t t = tri_first_[i]; t < tri_first_[i + 1]; ++t) {
+                    double c = cost_[tri_left_[t]] + cost_[tri_right_[t]];
+                    int64_t via = to_[tri_left_[t]];
+                    if (c < best || (c == best && via == via_[i])) {
+                        best = c;
+                        best_via = via;
+                    }
+                }
+                if (best == cost_[i] && best_via == via_[i]) continue;
+                if (best != cost_[i]) ++local_updated;
+                if (best_via != via_[i]) ++local_moved;
+                cost_[i] = best;
+                via_[i] = best_via;
+                dirty[i] = 1;
+            }
+            updated += local_updated;
+            moved += local_moved;
+        });
+        stats.shortcuts_updated += updated;
+        stats.vias_changed += moved;
+    }
+
+    for (size_t i = 0; i < dirty.size(); ++i) {
+        if (dirty[i]) changed_.push_back(static_cast<uint32_t>(i));
+    }
+    return stats;
+}
+
+void MetricCustomizer::write(const std::string& path) const {
+    PARQUET_ASSIGN_OR_THROW(auto infile, arrow::io::ReadableFile::Open(shortcuts_path_));
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+    std::shared_ptr<arrow::Schema> schema;
+    PARQUET_THROW_NOT_OK(reader->GetSchema(&schema));
+    int cost_index = schema->GetFieldIndex("cost");
+    int via_index = schema->GetFieldIndex("via_edge");
+    if (cost_index < 0 || via_index < 0) {
+        throw std::runtime_error("Missing cost or via_edge column in " + shortcuts_path_);
+    }
+    auto cost_field = schema->field(cost_index);
+    auto via_field = schema->field(via_index);
+
+    PARQUET_ASSIGN_OR_THROW(auto outfile, arrow::io::FileOutputStream::Open(path));
+    PARQUET_ASSIGN_OR_THROW(auto writer,
+                            parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), outfile));
+    size_t offset = 0;
+    for (int g = 0; g < reader->num_row_groups(); ++g) {
+        std::shared_ptr<arrow::Table> group;
+        PARQUET_THROW_NOT_OK(reader->ReadRowGroup(g, &group));
+        const int64_t rows = group->num_rows();
+        if (offset + rows > cost_.size()) break;
+
+        std::shared_ptr<arrow::ChunkedArray> costs;
+        switch (cost_field->type()->id()) {
+            case arrow::Type::DOUBLE: costs = cost_column<arrow::DoubleBuilder, double>(cost_, offset, rows); break;
+            case arrow::Type::FLOAT: costs = cost_column<arrow::FloatBuilder, float>(cost_, offset, rows); break;
+            default: throw std::runtime_error("Unsupported type for column cost: " + cost_field->type()->ToString());
+        }
+        const auto& vias = *group->column(via_index);
+        std::shared_ptr<arrow::ChunkedArray> merged_vias;
+        switch (via_field->type()->id()) {
+            case arrow::Type::INT32:
+                merged_vias = via_column<arrow::Int32Array, arrow::Int32Builder>(vias, via_, original_via_, offset); break;
+            case arrow::Type::INT64:
+                merged_vias = via_column<arrow::Int64Array, arrow::Int64Builder>(vias, via_, original_via_, offset); break;
+            case arrow::Type::UINT32:
+                merged_vias = via_column<arrow::UInt32Array, arrow::UInt32Builder>(vias, via_, original_via_, offset); break;
+            case arrow::Type::UINT64:
+                merged_vias = via_column<arrow::UInt64Array, arrow::UInt64Builder>(vias, via_, original_via_, offset); break;
+            default:
+                throw std::runtime_error("Unsupported type for column via_edge: " + via_field->type()->ToString());
+        }
+        PARQUET_ASSIGN_OR_THROW(group, group->SetColumn(cost_index, cost_field, costs));
+        PARQUET_ASSIGN_OR_THROW(group, group->SetColumn(via_index, via_field, merged_vias));
+        PARQUET_THROW_NOT_OK(writer->WriteTable(*group, rows));
+        offset += rows;
+    }
+    PARQUET_THROW_NOT_OK(writer->Close());
+    PARQUET_THROW_NOT_OK(outfile->Close());
+    if (offset != cost_.size()) {
+        throw std::runtime_error("Shortcut table changed since it was read: " + shortcuts_path_);
+    }
+}
+
+size_t MetricCustomizer::memory_bytes() const {
+    // Hash map nodes carry roughly two pointers of overhead each
+    constexpr size_t HASH_NODE_OVERHEAD = 32;
+    size_t bytes = vector_bytes(from_) + vector_bytes(to_) + vector_bytes(original_via_) + vector_bytes(via_) +
+                   vector_bytes(original_cost_) + vector_bytes(cost_) + vector_bytes(tri_first_) +
+                   vector_bytes(tri_left_) + vector_bytes(tri_right_) + vector_bytes(changed_);
+    for (const auto& level : levels_) bytes += vector_bytes(level);
+    for (const auto& [edge, rows] : base_by_edge_) {
+        bytes += sizeof(edge) + sizeof(rows) + HASH_NODE_OVERHEAD + vector_bytes(rows);
+    }
+    return bytes;
+}
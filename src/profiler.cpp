@@ -0,0 +1,294 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Count heap allocations per thread. Replacing the global operator new
+// affects every binary linking the engine, so it is only compiled into
+// profiling builds (-DROUTING_PROFILE_ALLOCATIONS=ON); elsewhere the
+// counters stay at zero and profiles say allocations were not counted.
+namespace {
+thread_local uint64_t t_allocations = 0;
+thread_local uint64_t t_allocated_bytes = 0;
+}
+
+#ifdef ROUTING_PROFILE_ALLOCATIONS
+
+namespace {
+
+void* counted_alloc(std::size_t size) noexcept {
+    ++t_allocations;
+    t_allocated_bytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+void* counted_aligned_alloc(std::size_t size, std::align_val_t align) noexcept {
+    ++t_allocations;
+    t_allocated_bytes += size;
+    // aligned_alloc wants the size to be a multiple of the alignment
+    auto alignment = static_cast<std::size_t>(align);
+    std::size_t rounded = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, rounded);
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* p = counted_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void* p = counted_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = counted_aligned_alloc(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    if (void* p = counted_aligned_alloc(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_aligned_alloc(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_aligned_alloc(size, align);
+}
+
+// malloc and aligned_alloc memory are both released with free
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+
+bool allocation_counters_available() { return true; }
+
+#else
+
+bool allocation_counters_available() { return false; }
+
+#endif
+
+uint64_t thread_allocation_count() { return t_allocations; }
+uint64_t thread_allocated_bytes() { return t_allocated_bytes; }
+
+namespace {
+
+enum Counter { CYCLES, INSTRUCTIONS, LLC_MISSES, CONTEXT_SWITCHES, NUM_COUNTERS };
+
+// Counters for the calling thread, opened on first use and kept open
+class ThreadCounters {
+public:
+    static ThreadCounters& get() {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+
+    bool available() const { return fds_[CYCLES] >= 0; }
+
+    uint64_t read(Counter c) const {
+#ifdef __linux__
+        uint64_t value = 0;
+        if (fds_[c] >= 0 && ::read(fds_[c], &value, sizeof(value)) == sizeof(value)) return value;
+#endif
+        return 0;
+    }
+
+    ~ThreadCounters() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+private:
+    ThreadCounters() {
+#ifdef __linux__
+        fds_[CYCLES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds_[INSTRUCTIONS] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds_[LLC_MISSES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds_[CONTEXT_SWITCHES] = open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+#endif
+    }
+
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_hv = 1;
+        // Counting kernel time needs perf_event_paranoid <= 1; fall back to user only
+        for (int exclude_kernel : {0, 1}) {
+            attr.exclude_kernel = exclude_kernel;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd >= 0) return fd;
+        }
+        return -1;
+    }
+#endif
+
+    int fds_[NUM_COUNTERS] = {-1, -1, -1, -1};
+};
+
+ProfileSample snapshot() {
+    auto& counters = ThreadCounters::get();
+    ProfileSample s;
+    s.wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    s.cycles = counters.read(CYCLES);
+    s.instructions = counters.read(INSTRUCTIONS);
+    s.llc_misses = counters.read(LLC_MISSES);
+    s.context_switches = counters.read(CONTEXT_SWITCHES);
+    s.allocations = t_allocations;
+    s.allocated_bytes = t_allocated_bytes;
+    return s;
+}
+
+ProfileSample delta(const ProfileSample& end, const ProfileSample& start) {
+    ProfileSample d;
+    d.wall_us = end.wall_us - start.wall_us;
+    d.cycles = end.cycles - start.cycles;
+    d.instructions = end.instructions - start.instructions;
+    d.llc_misses = end.llc_misses - start.llc_misses;
+    d.context_switches = end.context_switches - start.context_switches;
+    d.allocations = end.allocations - start.allocations;
+    d.allocated_bytes = end.allocated_bytes - start.allocated_bytes;
+    return d;
+}
+
+} // namespace
+
+bool perf_counters_available() {
+    return ThreadCounters::get().available();
+}
+
+ProfileSample& ProfileSample::operator+=(const ProfileSample& other) {
+    wall_us += other.wall_us;
+    cycles += other.cycles;
+    instructions += other.instructions;
+    llc_misses += other.llc_misses;
+    context_switches += other.context_switches;
+    allocations += other.allocations;
+    allocated_bytes += other.allocated_bytes;
+    return *this;
+}
+
+nlohmann::json ProfileSample::to_json() const {
+    return {
+        {"wall_us", wall_us},
+        {"cycles", cycles},
+        {"instructions", instructions},
+        {"ipc", cycles ? static_cast<double>(instructions) / cycles : 0.0},
+        {"llc_misses", llc_misses},
+        {"context_switches", context_switches},
+        {"allocations", allocations},
+        {"allocated_bytes", allocated_bytes}
+    };
+}
+
+void RequestProfiler::begin(const char* stage) {
+    if (!enabled_) return;
+    current_ = stage;
+    start_ = snapshot();
+}
+
+void RequestProfiler::end() {
+    if (!enabled_ || !current_) return;
+    stages_.push_back({current_, delta(snapshot(), start_)});
+    current_ = nullptr;
+}
+
+ProfileSample RequestProfiler::total() const {
+    ProfileSample sum;
+    for (const auto& [name, sample] : stages_) sum += sample;
+    return sum;
+}
+
+nlohmann::json RequestProfiler::to_json() const {
+    nlohmann::json stages = nlohmann::json::object();
+    for (const auto& [name, sample] : stages_) stages[name] = sample.to_json();
+    return {
+        {"perf_counters", perf_counters_available()},
+        {"allocation_counters", allocation_counters_available()},
+        {"stages", stages},
+        {"total", total().to_json()}
+    };
+}
+
+void ProfileAggregator::record(const RequestProfiler& profiler, const std::string& label) {
+    if (!profiler.enabled()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++requests_;
+    for (const auto& [name, sample] : profiler.stages()) {
+        auto it = std::find_if(stages_.begin(), stages_.end(), [&](const auto& s) { return s.first == name; });
+        if (it == stages_.end()) {
+            stages_.push_back({name, StageStats{}});
+            it = stages_.end() - 1;
+        }
+        StageStats& stats = it->second;
+        ++stats.count;
+        stats.sum += sample;
+        stats.max_wall_us = std::max(stats.max_wall_us, sample.wall_us);
+        size_t bucket = 0;
+        for (uint64_t w = sample.wall_us; w > 1 && bucket + 1 < HISTOGRAM_BUCKETS; w >>= 1) ++bucket;
+        ++stats.wall_histogram[bucket];
+    }
+
+    uint64_t total_us = profiler.total().wall_us;
+    if (slowest_.size() < SLOWEST_KEPT || total_us > slowest_.back().first) {
+        nlohmann::json entry = profiler.to_json();
+        entry["label"] = label;
+        slowest_.push_back({total_us, std::move(entry)});
+        std::sort(slowest_.begin(), slowest_.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+        if (slowest_.size() > SLOWEST_KEPT) slowest_.pop_back();
+    }
+}
+
+nlohmann::json ProfileAggregator::to_json() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nlohmann::json stages = nlohmann::json::object();
+    for (const auto& [name, stats] : stages_) {
+        nlohmann::json histogram = nlohmann::json::array();
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            if (stats.wall_histogram[b] == 0) continue;
+            histogram.push_back({{"le_us", 2ull << b}, {"count", stats.wall_histogram[b]}});
+        }
+        stages[name] = {
+            {"count", stats.count},
+            {"sum", stats.sum.to_json()},
+            {"mean_wall_us", stats.count ? static_cast<double>(stats.sum.wall_us) / stats.count : 0.0},
+            {"max_wall_us", stats.max_wall_us},
+            {"wall_histogram", histogram}
+        };
+    }
+    nlohmann::json slowest = nlohmann::json::array();
+    for (const auto& [us, entry] : slowest_) slowest.push_back(entry);
+    return {
+        {"requests", requests_},
+        {"stages", stages},
+        {"slowest", slowest}
+    };
+}
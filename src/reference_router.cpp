@@ -0,0 +1,91 @@
+#include "reference_router.hpp"
+#include "shortcut_table.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+ReferenceRouter::ReferenceRouter(const std::string& shortcuts_path) {
+    auto table = read_shortcut_table(shortcuts_path);
+    const auto& from = table.from;
+    const auto& to = table.to;
+    const auto& cost = table.cost;
+
+    auto node = [this](int64_t edge) {
+        auto [it, inserted] = index_.emplace(static_cast<uint32_t>(edge), static_cast<uint32_t>(ids_.size()));
+        if (inserted) ids_.push_back(static_cast<uint32_t>(edge));
+        return it->second;
+    };
+
+    // Counting sort of the base rows by tail node into CSR arrays
+    std::vector<std::pair<uint32_t, uint32_t>> arcs; // (tail, row)
+    for (size_t i = 0; i < cost.size(); ++i) {
+        if (!table.is_base(i) || from[i] < 0 || to[i] < 0) continue;
+        uint32_t tail = node(from[i]);
+        node(to[i]);
+        arcs.push_back({tail, static_cast<uint32_t>(i)});
+    }
+    first_.assign(ids_.size() + 1, 0);
+    for (const auto& arc : arcs) ++first_[arc.first + 1];
+    for (size_t v = 0; v < ids_.size(); ++v) first_[v + 1] += first_[v];
+    head_.resize(arcs.size());
+    cost_.resize(arcs.size());
+    std::vector<uint32_t> next(first_.begin(), first_.end() - 1);
+    for (const auto& [tail, row] : arcs) {
+        uint32_t slot = next[tail]++;
+        head_[slot] = index_.at(static_cast<uint32_t>(to[row]));
+        cost_[slot] = cost[row];
+    }
+}
+
+double ReferenceRouter::query(const std::vector<std::pair<uint32_t, double>>& sources,
+                              const std::vector<std::pair<uint32_t, double>>& targets) const {
+    constexpr double INF = std::numeric_limits<double>::infinity();
+
+    // Per-thread labels, reset through the touched list after each query
+    thread_local std::vector<double> dist;
+    thread_local std::vector<uint32_t> touched;
+    if (dist.size() < ids_.size()) dist.resize(ids_.size(), INF);
+
+    std::vector<std::pair<uint32_t, double>> target_nodes;
+    for (const auto& [edge, offset] : targets) {
+        auto it = index_.find(edge);
+        if (it != index_.end()) target_nodes.push_back({it->second, offset});
+    }
+
+    using Entry = std::pair<double, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (const auto& [edge, offset] : sources) {
+        auto it = index_.find(edge);
+        if (it == index_.end() || offset >= dist[it->second]) continue;
+        if (dist[it->second] == INF) touched.push_back(it->second);
+        dist[it->second] = offset;
+        queue.push({offset, it->second});
+    }
+
+    double best = INF;
+    while (!queue.empty()) {
+        auto [d, v] = queue.top();
+        queue.pop();
+        if (d > dist[v]) continue;
+        // Target offsets are non-negative, so nothing popped later can improve best
+        if (d >= best) break;
+        for (const auto& [node, offset] : target_nodes) {
+            if (node == v) best = std::min(best, d + offset);
+        }
+        for (uint32_t a = first_[v]; a < first_[v + 1]; ++a) {
+            uint32_t w = head_[a];
+            double nd = d + cost_[a];
+            if (nd < dist[w]) {
+                if (dist[w] == INF) touched.push_back(w);
+                dist[w] = nd;
+                queue.push({nd, w});
+            }
+        }
+    }
+
+    for (uint32_t v : touched) dist[v] = INF;
+    touched.clear();
+    return best;
+}
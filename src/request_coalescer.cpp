@@ -0,0 +1,47 @@
+#include "request_coalescer.hpp"
+
+nlohmann::json RequestCoalescer::run(const std::string& key, const std::function<nlohmann::json()>& compute) {
+    std::promise<nlohmann::json> promise;
+    std::shared_future<nlohmann::json> result;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = in_flight_.find(key);
+        if (it != in_flight_.end()) {
+            result = it->second;
+        } else {
+            result = promise.get_future().share();
+            in_flight_.emplace(key, result);
+            leader = true;
+        }
+    }
+
+    if (!leader) {
+        // Rethrows if the leader failed
+        ++followers_;
+        return result.get();
+    }
+
+    ++leaders_;
+    try {
+        promise.set_value(compute());
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_.erase(key);
+    }
+    return result.get();
+}
+
+nlohmann::json RequestCoalescer::stats() const {
+    uint64_t leaders = leaders_;
+    uint64_t followers = followers_;
+    uint64_t total = leaders + followers;
+    return {
+        {"computed", leaders},
+        {"coalesced", followers},
+        {"saved_ratio", total ? static_cast<double>(followers) / total : 0.0}
+    };
+}
@@ -1,12 +1,18 @@
 #include "routing_engine.hpp"
+#include "edges_csv.hpp"
+#include "geo_kernels.hpp"
+#include "profiler.hpp"
 #include "h3_utils.hpp"
 #include <filesystem>
 #include <iostream>
+#include <thread>
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // Include the CH library headers
@@ -17,6 +23,9 @@
 #include <boost/geometry/geometries/box.hpp>
 #include <boost/geometry/index/rtree.hpp>
 #include <regex>
+#include <h3api.h>
+#include <parquet/file_reader.h>
+#include <unistd.h>
 
 namespace fs = std::filesystem;
 
@@ -28,56 +37,175 @@ namespace bgi = boost::geometry::index;
 
 RoutingEngine::RoutingEngine() {}
 
-// Helper to parse WKT LINESTRING
-std::vector<std::pair<double, double>> parse_wkt_linestring(const std::string& wkt) {
-    std::vector<std::pair<double, double>> points;
-    // Simple regex to find coordinate pairs
-    // WKT format: LINESTRING (lon lat, lon lat, ...)
-    try {
-        size_t start = wkt.find('(');
-        size_t end = wkt.find(')');
-        if (start == std::string::npos || end == std::string::npos) return points;
-        
-        std::string coords_str = wkt.substr(start + 1, end - start - 1);
-        std::stringstream ss(coords_str);
-        std::string segment;
-        
-        while (std::getline(ss, segment, ',')) {
-            std::stringstream point_ss(segment);
-            double lon, lat;
-            if (point_ss >> lon >> lat) {
-                points.push_back({lat, lon}); // Store as Lat, Lon for API consistency
-            }
+const RoutingEngine::EdgeGeometry* RoutingEngine::Dataset::find_geometry(uint32_t edge_id) const {
+    if (shared) {
+        const auto* slot = shared->find_edge(edge_id);
+        return slot ? &slot->geometry : nullptr;
+    }
+    auto it = edge_geometries.find(edge_id);
+    return it == edge_geometries.end() ? nullptr : &it->second;
+}
+
+// Default-mode seed pairs below which the pruning pilot search is skipped
+constexpr size_t PRUNE_MIN_SEED_PAIRS = 16;
+
+// Resolution used for H3 edge buckets (~174m hexagon edge)
+constexpr int H3_BUCKET_RES = 9;
+// Polylines scored per call of the batched distance kernel
+constexpr size_t NEAREST_SCORE_BATCH = 16;
+
+// Batches below this many points run on the calling thread; starting
+// helpers costs more than it saves
+constexpr size_t BATCH_INLINE_POINTS = 4096;
+constexpr size_t BATCH_MIN_POINTS_PER_THREAD = 1024;
+
+// Most k-rings one H3 lookup scans (about 16 km at the bucket resolution)
+constexpr int H3_MAX_RINGS = 64;
+
+// Collect the H3 cells a polyline (lat, lon points) passes through.
+// Segments are sampled at half the cell edge length so no cell is skipped.
+static void collect_edge_cells(const std::vector<std::pair<double, double>>& points,
+                               int res, double cell_edge_m,
+                               std::vector<uint64_t>& cells) {
+    cells.clear();
+    double step_m = cell_edge_m / 2.0;
+    cells.push_back(h3_lat_lng_to_cell(points[0].first, points[0].second, res));
+    for (size_t i = 1; i < points.size(); ++i) {
+        const auto& a = points[i - 1];
+        const auto& b = points[i];
+        double dy = (b.first - a.first) * 111320.0;
+        double dx = (b.second - a.second) * 111320.0 * std::cos(a.first * M_PI / 180.0);
+        int steps = std::max(1, static_cast<int>(std::ceil(std::sqrt(dx * dx + dy * dy) / step_m)));
+        for (int s = 1; s <= steps; ++s) {
+            double t = static_cast<double>(s) / steps;
+            cells.push_back(h3_lat_lng_to_cell(a.first + t * (b.first - a.first),
+                                               a.second + t * (b.second - a.second), res));
         }
-    } catch (...) {
-        // Ignore parsing errors for robustness
-    }
-    return points;
-}
-
-// Minimal CSV parser handling quotes
-std::vector<std::string> parse_csv_line(const std::string& line) {
-    std::vector<std::string> result;
-    bool in_quotes = false;
-    std::string current;
-    for (char c : line) {
-        if (c == '"') {
-            in_quotes = !in_quotes;
-        } else if (c == ',' && !in_quotes) {
-            result.push_back(current);
-            current.clear();
-        } else {
-            current.push_back(c);
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+}
+
+// Rough resident cost of the CH graph; ShortcutGraph does not report its size
+constexpr size_t GRAPH_BYTES_PER_SHORTCUT = 48;
+constexpr size_t GRAPH_BYTES_PER_EDGE = 64;
+// Per-element overhead of hash map nodes and R-tree nodes
+constexpr size_t HASH_NODE_OVERHEAD = 32;
+constexpr size_t RTREE_NODE_OVERHEAD = 16;
+
+static size_t estimate_memory_bytes(const RoutingEngine::Dataset& dataset, size_t shortcut_rows,
+                                    size_t expansion_cache_bytes) {
+    size_t edges = dataset.edge_count();
+    size_t bytes = shortcut_rows * GRAPH_BYTES_PER_SHORTCUT + edges * GRAPH_BYTES_PER_EDGE;
+    if (dataset.shared) {
+        bytes += dataset.shared->size_bytes();
+    } else {
+        bytes += dataset.owned_points.capacity() * sizeof(std::pair<double, double>);
+        bytes += edges * (sizeof(RoutingEngine::EdgeGeometry) + HASH_NODE_OVERHEAD);
+        bytes += dataset.rtree.size() * (sizeof(Value) + RTREE_NODE_OVERHEAD);
+    }
+    bytes += dataset.h3_buckets.entries.capacity() * sizeof(Value);
+    bytes += dataset.h3_buckets.cells.size() * (sizeof(uint64_t) + 2 * sizeof(uint32_t) + HASH_NODE_OVERHEAD);
+    if (dataset.ordering) {
+        bytes += dataset.ordering->original_ids.size() * (3 * sizeof(uint32_t) + HASH_NODE_OVERHEAD);
+    }
+    return bytes + expansion_cache_bytes;
+}
+
+// Bounding box of an edges.csv without building anything. Only the
+// coordinates after each "LINESTRING (" are read; no row is split into
+// columns and no geometry is kept.
+static bool scan_edges_bounds(const std::string& edges_path, Box& bounds) {
+    std::ifstream file(edges_path);
+    std::string line;
+    if (!std::getline(file, line)) return false;
+
+    bg::assign_inverse(bounds);
+    bool any = false;
+    while (std::getline(file, line)) {
+        size_t pos = line.find("LINESTRING");
+        if (pos == std::string::npos) continue;
+        pos = line.find('(', pos);
+        if (pos == std::string::npos) continue;
+        const char* p = line.c_str() + pos + 1;
+        while (true) {
+            char* end = nullptr;
+            double lon = std::strtod(p, &end);
+            if (end == p) break;
+            p = end;
+            double lat = std::strtod(p, &end);
+            if (end == p) break;
+            bg::expand(bounds, Point(lon, lat));
+            any = true;
+            p = end;
+            while (*p == ' ' || *p == ',') ++p;
+        }
+    }
+    return any;
+}
+
+// scan_edges_bounds, cached in a "bounds" file beside edges.csv that is
+// reused while the file keeps its size and mtime
+static bool cached_edges_bounds(const std::string& edges_path, Box& bounds) {
+    std::error_code ec;
+    auto size = fs::file_size(edges_path, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(edges_path, ec).time_since_epoch().count();
+    if (ec) return false;
+    auto cache_path = fs::path(edges_path).parent_path() / "bounds";
+
+    std::ifstream in(cache_path);
+    uintmax_t cached_size = 0;
+    long long cached_mtime = 0;
+    double min_lon, min_lat, max_lon, max_lat;
+    if (in >> cached_size >> cached_mtime >> min_lon >> min_lat >> max_lon >> max_lat &&
+        cached_size == size && cached_mtime == static_cast<long long>(mtime)) {
+        bounds = Box(Point(min_lon, min_lat), Point(max_lon, max_lat));
+        return true;
+    }
+
+    if (!scan_edges_bounds(edges_path, bounds)) return false;
+    // Best effort: a read-only dataset directory is scanned on every start
+    auto tmp_path = cache_path.string() + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(tmp_path);
+        out << std::setprecision(17) << size << ' ' << mtime << '\n'
+            << bounds.min_corner().get<0>() << ' ' << bounds.min_corner().get<1>() << ' '
+            << bounds.max_corner().get<0>() << ' ' << bounds.max_corner().get<1>() << '\n';
+        if (!out) {
+            fs::remove(tmp_path, ec);
+            return true;
         }
     }
-    result.push_back(current);
-    return result;
+    fs::rename(tmp_path, cache_path, ec);
+    if (ec) fs::remove(tmp_path, ec);
+    return true;
 }
 
 bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::string& datasets_path,
                                  const std::string& explicit_shortcuts_path,
-                                 const std::string& explicit_edges_path) {
+                                 const std::string& explicit_edges_path,
+                                 const std::string& spatial_index,
+                                 bool reorder_edges) {
+    return load_dataset_internal(dataset_name, datasets_path, explicit_shortcuts_path, explicit_edges_path,
+                                 spatial_index, reorder_edges, false) != nullptr;
+}
+
+std::shared_ptr<RoutingEngine::Dataset> RoutingEngine::load_dataset_internal(
+    const std::string& dataset_name, const std::string& datasets_path,
+    const std::string& explicit_shortcuts_path, const std::string& explicit_edges_path,
+    const std::string& spatial_index, bool reorder_edges, bool on_demand) {
     try {
+        SpatialBackend backend;
+        if (spatial_index == "rtree") {
+            backend = SpatialBackend::RTree;
+        } else if (spatial_index == "h3") {
+            backend = SpatialBackend::H3Buckets;
+        } else {
+            std::cerr << "Unknown spatial index: " << spatial_index << " (expected rtree or h3)" << std::endl;
+            return nullptr;
+        }
+
         std::string shortcuts_path;
         std::string edges_path;
 
@@ -88,7 +216,7 @@ bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::str
             std::string dataset_dir = datasets_path + "/" + dataset_name;
             if (!fs::exists(dataset_dir)) {
                 std::cerr << "Dataset directory not found: " << dataset_dir << std::endl;
-                return false;
+                return nullptr;
             }
             shortcuts_path = dataset_dir + "/shortcuts.parquet";
             edges_path = dataset_dir + "/edges.csv";
@@ -98,24 +226,113 @@ bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::str
             std::cerr << "Required files not found: " << std::endl;
             std::cerr << "  Shortcuts: " << shortcuts_path << std::endl;
             std::cerr << "  Edges: " << edges_path << std::endl;
-            return false;
+            return nullptr;
         }
 
-        Dataset dataset;
+        auto dataset_ptr = std::make_shared<Dataset>();
+        Dataset& dataset = *dataset_ptr;
         dataset.name = dataset_name;
+        dataset.shortcuts_path = shortcuts_path;
+        dataset.edges_path = edges_path;
+        dataset.spatial_backend = backend;
+        bg::assign_inverse(dataset.bounds);
+
+        // Shared memory: attach to a segment another process built from the
+        // same files, or build one from the scan below
+        bool use_shared = shared_memory_ && backend == SpatialBackend::RTree;
+        if (shared_memory_ && !use_shared) {
+            std::cout << "Shared memory supports the rtree backend only; loading " << dataset_name
+                      << " privately" << std::endl;
+        }
+        SharedDatasetSegment::SourceStamp stamp;
+        std::string segment_name;
+        std::vector<Value> shared_entries;
+        if (use_shared) {
+            stamp = SharedDatasetSegment::stamp(shortcuts_path, edges_path, reorder_edges);
+            segment_name = SharedDatasetSegment::segment_name(dataset_name);
+            try {
+                dataset.shared = SharedDatasetSegment::attach(segment_name, stamp, shared_memory_persistent_);
+            } catch (const std::exception& e) {
+                std::cerr << "Could not attach shared segment " << segment_name << ": " << e.what() << std::endl;
+                use_shared = false;
+            }
+        }
+
+        // Hilbert renumbering writes renumbered copies of both files beside
+        // the dataset, or under the temp directory when the dataset directory
+        // is read-only, reused while the inputs are unchanged. Everything
+        // below, including later weight updates, reads the copies. An
+        // attached segment was built from those copies, so only their id
+        // table is read; without them the segment cannot be used. If no
+        // cache directory is writable the dataset loads in its original order.
+        auto cache_dirs = reorder_cache_dirs(shortcuts_path, edges_path);
+        if (reorder_edges && dataset.shared) {
+            std::optional<ReorderedDataset> reordered;
+            for (const auto& cache_dir : cache_dirs) {
+                if ((reordered = find_reordered_cached(shortcuts_path, edges_path, cache_dir))) break;
+            }
+            if (reordered) {
+                dataset.ordering = std::make_unique<EdgeOrdering>(std::move(reordered->ordering));
+                dataset.shortcuts_path = reordered->shortcuts_path;
+                dataset.edges_path = reordered->edges_path;
+            } else {
+                std::cout << "Renumbered copies of " << dataset_name << " are missing; not attaching to "
+                          << segment_name << std::endl;
+                dataset.shared.reset();
+            }
+        }
+        if (reorder_edges && !dataset.shared) {
+            std::optional<ReorderedDataset> reordered;
+            for (const auto& cache_dir : cache_dirs) {
+                try {
+                    reordered = reorder_edges_hilbert_cached(shortcuts_path, edges_path, cache_dir);
+                    std::cout << (reordered->rebuilt ? "Renumbered" : "Reusing renumbered") << " edges of "
+                              << dataset_name << " in " << cache_dir << std::endl;
+                    break;
+                } catch (const std::exception& e) {
+                    std::cerr << "Could not cache renumbered edges of " << dataset_name << " in " << cache_dir
+                              << ": " << e.what() << std::endl;
+                }
+            }
+            if (reordered) {
+                dataset.ordering = std::make_unique<EdgeOrdering>(std::move(reordered->ordering));
+                dataset.shortcuts_path = reordered->shortcuts_path;
+                dataset.edges_path = reordered->edges_path;
+            } else {
+                std::cerr << "Warning: loading " << dataset_name << " without edge renumbering" << std::endl;
+                stamp.reordered = false;
+            }
+        }
+        if (dataset.shared) {
+            std::cout << "Attached to shared segment " << segment_name << " ("
+                      << dataset.shared->size_bytes() / (1024 * 1024) << " MB)" << std::endl;
+        }
+
+        // The graph library only builds from files, so every process loads
+        // the graph and its edge metadata even when geometry is shared
+        auto graph = std::make_shared<ShortcutGraph>();
+        std::cout << "Loading shortcuts for " << dataset_name << " from " << dataset.shortcuts_path << std::endl;
+        graph->load_shortcuts(dataset.shortcuts_path);
         
-        std::cout << "Loading shortcuts for " << dataset_name << " from " << shortcuts_path << std::endl;
-        dataset.graph.load_shortcuts(shortcuts_path);
-        
-        std::cout << "Loading edge metadata for " << dataset_name << " from " << edges_path << std::endl;
-        dataset.graph.load_edge_metadata(edges_path);
+        std::cout << "Loading edge metadata for " << dataset_name << " from " << dataset.edges_path << std::endl;
+        graph->load_edge_metadata(dataset.edges_path);
 
-        std::cout << "Loading geometries and building spatial index..." << std::endl;
-        std::ifstream file(edges_path);
+        // An attached segment already holds the geometry and index
+        std::ifstream file;
+        if (!dataset.shared) file.open(dataset.edges_path);
         std::string line;
+
+        // (cell, entry) pairs, grouped into contiguous buckets after the scan
+        std::vector<std::pair<uint64_t, Value>> cell_entries;
+        std::vector<uint64_t> edge_cells;
+        if (backend == SpatialBackend::H3Buckets) {
+            dataset.h3_buckets.res = H3_BUCKET_RES;
+            getHexagonEdgeLengthAvgM(H3_BUCKET_RES, &dataset.h3_buckets.cell_edge_m);
+        }
         
         // Read header to find column indices
-        if (std::getline(file, line)) {
+        if (!dataset.shared && std::getline(file, line)) {
+            std::cout << "Loading geometries and building spatial index..." << std::endl;
             auto headers = parse_csv_line(line);
             int id_idx = -1;
             int geom_idx = -1;
@@ -127,7 +344,7 @@ bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::str
 
             if (id_idx == -1 || geom_idx == -1) {
                  std::cerr << "Missing id or geometry column in edges.csv" << std::endl;
-                 return false;
+                 return nullptr;
             }
 
             while (std::getline(file, line)) {
@@ -141,7 +358,12 @@ bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::str
                     auto points = parse_wkt_linestring(wkt);
                     
                     if (!points.empty()) {
-                        dataset.edge_geometries[edge_id] = points;
+                        EdgeGeometry geom;
+                        geom.offset = static_cast<uint32_t>(dataset.owned_points.size());
+                        geom.count = static_cast<uint32_t>(points.size());
+                        geom.length_m = polyline_length_m(points.data(), points.size());
+                        dataset.owned_points.insert(dataset.owned_points.end(), points.begin(), points.end());
+                        dataset.edge_geometries[edge_id] = geom;
                         
                         // Add to R-tree
                         double min_lat = points[0].first, max_lat = points[0].first;
@@ -156,37 +378,286 @@ bool RoutingEngine::load_dataset(const std::string& dataset_name, const std::str
                         
                         // R-tree stores x=lon, y=lat
                         Box box(Point(min_lon, min_lat), Point(max_lon, max_lat));
-                        dataset.rtree.insert(std::make_pair(box, edge_id));
+                        bg::expand(dataset.bounds, box);
+                        if (use_shared) {
+                            shared_entries.push_back(std::make_pair(box, edge_id));
+                        } else if (backend == SpatialBackend::RTree) {
+                            dataset.rtree.insert(std::make_pair(box, edge_id));
+                        } else {
+                            collect_edge_cells(points, dataset.h3_buckets.res,
+                                               dataset.h3_buckets.cell_edge_m, edge_cells);
+                            for (uint64_t cell : edge_cells) {
+                                cell_entries.push_back({cell, std::make_pair(box, edge_id)});
+                            }
+                        }
                     }
                 } catch (...) {
                     continue;
                 }
             }
         }
+
+        if (backend == SpatialBackend::H3Buckets) {
+            std::sort(cell_entries.begin(), cell_entries.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+            auto& buckets = dataset.h3_buckets;
+            buckets.entries.reserve(cell_entries.size());
+            for (size_t i = 0; i < cell_entries.size(); ++i) {
+                uint64_t cell = cell_entries[i].first;
+                if (i == 0 || cell != cell_entries[i - 1].first) {
+                    buckets.cells[cell] = {static_cast<uint32_t>(i), static_cast<uint32_t>(i)};
+                }
+                buckets.cells[cell].second = static_cast<uint32_t>(i + 1);
+                buckets.entries.push_back(cell_entries[i].second);
+            }
+            std::cout << "Built H3 buckets: " << buckets.cells.size() << " cells, "
+                      << buckets.entries.size() << " entries" << std::endl;
+        }
         
+        // Move the scanned geometry into a new segment; the R-tree is
+        // bulk-loaded there
+        if (use_shared && !dataset.shared) {
+            std::vector<SharedDatasetSegment::EdgeSlot> slots;
+            slots.reserve(dataset.edge_geometries.size());
+            for (const auto& [edge_id, geom] : dataset.edge_geometries) slots.push_back({edge_id, geom});
+            std::sort(slots.begin(), slots.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+            try {
+                dataset.shared = SharedDatasetSegment::create(segment_name, stamp, dataset.owned_points,
+                                                              slots, shared_entries, shared_memory_persistent_);
+                std::cout << "Created shared segment " << segment_name << " ("
+                          << dataset.shared->size_bytes() / (1024 * 1024) << " MB)" << std::endl;
+                std::vector<std::pair<double, double>>().swap(dataset.owned_points);
+                std::unordered_map<uint32_t, EdgeGeometry>().swap(dataset.edge_geometries);
+            } catch (const std::exception& e) {
+                std::cerr << "Could not create shared segment " << segment_name << ": " << e.what()
+                          << "; keeping " << dataset_name << " private" << std::endl;
+                dataset.rtree = decltype(dataset.rtree)(shared_entries.begin(), shared_entries.end());
+            }
+        }
+        if (dataset.shared) {
+            dataset.geometry_points = dataset.shared->points();
+            if (dataset.shared->rtree_size() > 0) dataset.bounds = dataset.shared->bounds();
+        } else {
+            dataset.geometry_points = dataset.owned_points;
+        }
+
+        dataset.metric.store(std::make_shared<const Dataset::Metric>(Dataset::Metric{
+            graph, std::make_shared<ShortcutExpansionCache>(expansion_cache_bytes_, expansion_cache_pin_hits_)}));
+        size_t shortcut_rows = parquet::ParquetFileReader::OpenFile(dataset.shortcuts_path)->metadata()->num_rows();
+        dataset.memory_bytes = estimate_memory_bytes(dataset, shortcut_rows, expansion_cache_bytes_);
+        dataset.last_used = ++access_clock_;
         dataset.loaded = true;
-        datasets_[dataset_name] = std::move(dataset);
+        {
+            std::unique_lock lock(datasets_mutex_);
+            datasets_[dataset_name] = dataset_ptr;
+        }
+
+        CatalogEntry entry;
+        entry.shortcuts_path = shortcuts_path;
+        entry.edges_path = edges_path;
+        entry.spatial_index = spatial_index;
+        entry.reorder_edges = reorder_edges;
+        entry.on_demand = on_demand;
+        entry.has_bounds = dataset.edge_count() > 0;
+        entry.bounds = dataset.bounds;
+        register_catalog_entry(dataset_name, entry);
         
-        std::cout << "Successfully loaded dataset: " << dataset_name << std::endl;
-        return true;
+        std::cout << "Successfully loaded dataset: " << dataset_name
+                  << " (~" << dataset.memory_bytes / (1024 * 1024) << " MB)" << std::endl;
+        evict_to_budget(dataset_name);
+        return dataset_ptr;
 
     } catch (const std::exception& e) {
         std::cerr << "Error loading dataset " << dataset_name << ": " << e.what() << std::endl;
-        return false;
+        return nullptr;
     }
 }
 
 bool RoutingEngine::unload_dataset(const std::string& dataset_name) {
-    auto it = datasets_.find(dataset_name);
-    if (it != datasets_.end()) {
+    // Forget the dataset's files too, so lazy loading does not bring it back
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        auto it = catalog_.find(dataset_name);
+        if (it != catalog_.end()) {
+            if (it->second.has_bounds) catalog_index_.remove(std::make_pair(it->second.bounds, dataset_name));
+            catalog_.erase(it);
+        }
+    }
+
+    // In-flight queries keep their own reference to the dataset
+    std::shared_ptr<Dataset> dataset;
+    {
+        std::unique_lock lock(datasets_mutex_);
+        auto it = datasets_.find(dataset_name);
+        if (it == datasets_.end()) return false;
+        dataset = std::move(it->second);
         datasets_.erase(it);
-        std::cout << "Successfully unloaded dataset: " << dataset_name << std::endl;
-        return true;
     }
-    return false;
+    // A persistent segment outlives every process until explicitly
+    // unloaded; others go when the last process using them detaches
+    if (shared_memory_persistent_ && dataset->shared && dataset->shared->unlink()) {
+        std::cout << "Removed shared segment " << dataset->shared->name() << std::endl;
+    }
+    std::cout << "Successfully unloaded dataset: " << dataset_name << std::endl;
+    return true;
+}
+
+std::shared_ptr<RoutingEngine::Dataset> RoutingEngine::get_dataset(const std::string& dataset_name) const {
+    std::shared_lock lock(datasets_mutex_);
+    auto it = datasets_.find(dataset_name);
+    if (it == datasets_.end()) return nullptr;
+    it->second->last_used = ++access_clock_;
+    return it->second;
+}
+
+std::shared_ptr<RoutingEngine::Dataset> RoutingEngine::acquire_dataset(const std::string& dataset_name) {
+    auto dataset = get_dataset(dataset_name);
+    if (dataset || !lazy_loading_) return dataset;
+
+    CatalogEntry entry;
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        auto it = catalog_.find(dataset_name);
+        if (it == catalog_.end()) return nullptr;
+        entry = it->second;
+    }
+
+    // Single flight: the first request loads, the others wait for it. The
+    // dataset travels through the future, so an eviction right after the
+    // load cannot leave a waiter empty-handed.
+    std::promise<std::shared_ptr<Dataset>> promise;
+    std::shared_future<std::shared_ptr<Dataset>> pending;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        if ((dataset = get_dataset(dataset_name))) return dataset;
+        auto it = pending_loads_.find(dataset_name);
+        if (it != pending_loads_.end()) {
+            pending = it->second;
+        } else {
+            pending = promise.get_future().share();
+            pending_loads_[dataset_name] = pending;
+            leader = true;
+        }
+    }
+
+    if (leader) {
+        std::cout << "Loading dataset on demand: " << dataset_name << std::endl;
+        dataset = load_dataset_internal(dataset_name, datasets_path_, entry.shortcuts_path, entry.edges_path,
+                                        entry.spatial_index, entry.reorder_edges, entry.on_demand);
+        promise.set_value(dataset);
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_loads_.erase(dataset_name);
+        return dataset;
+    }
+    return pending.get();
+}
+
+void RoutingEngine::register_catalog_entry(const std::string& dataset_name, const CatalogEntry& entry) {
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+    auto it = catalog_.find(dataset_name);
+    if (it != catalog_.end() && it->second.has_bounds) {
+        catalog_index_.remove(std::make_pair(it->second.bounds, dataset_name));
+    }
+    catalog_[dataset_name] = entry;
+    if (entry.has_bounds) {
+        catalog_index_.insert(std::make_pair(entry.bounds, dataset_name));
+    }
+}
+
+void RoutingEngine::evict_to_budget(const std::string& keep) {
+    if (!lazy_loading_ || memory_budget_bytes_ == 0) return;
+
+    // Only datasets found by the directory scan come back on the next
+    // request; explicitly loaded ones stay resident
+    std::unordered_set<std::string> reloadable;
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex_);
+        for (const auto& [name, entry] : catalog_) {
+            if (entry.on_demand) reloadable.insert(name);
+        }
+    }
+
+    std::unique_lock lock(datasets_mutex_);
+    size_t used = 0;
+    for (const auto& [name, dataset] : datasets_) used += dataset->memory_bytes;
+
+    while (used > memory_budget_bytes_) {
+        // A reload would drop /weights overrides, so those datasets stay
+        auto victim = datasets_.end();
+        for (auto it = datasets_.begin(); it != datasets_.end(); ++it) {
+            if (it->first == keep || !reloadable.count(it->first) || it->second->overridden) continue;
+            if (victim == datasets_.end() || it->second->last_used < victim->second->last_used) victim = it;
+        }
+        if (victim == datasets_.end()) break;
+        std::cout << "Evicting dataset " << victim->first << " to stay within memory budget" << std::endl;
+        // A shared segment's pages stay in tmpfs while another process maps
+        // it (or, if persistent, until unloaded), so only the private part
+        // is assumed to be freed
+        size_t freed = victim->second->memory_bytes;
+        if (victim->second->shared) freed -= std::min(freed, victim->second->shared->size_bytes());
+        used -= freed;
+        datasets_.erase(victim);
+    }
+}
+
+void RoutingEngine::configure_lazy_loading(const std::string& datasets_path, bool enabled,
+                                           size_t budget_bytes, const std::string& spatial_index,
+                                           bool reorder_edges) {
+    datasets_path_ = datasets_path;
+    lazy_loading_ = enabled;
+    memory_budget_bytes_ = budget_bytes;
+    if (!enabled || !fs::exists(datasets_path)) return;
+
+    for (const auto& dir : fs::directory_iterator(datasets_path)) {
+        if (!dir.is_directory()) continue;
+        CatalogEntry entry;
+        entry.shortcuts_path = (dir.path() / "shortcuts.parquet").string();
+        entry.edges_path = (dir.path() / "edges.csv").string();
+        entry.spatial_index = spatial_index;
+        entry.reorder_edges = reorder_edges;
+        entry.on_demand = true;
+        if (!fs::exists(entry.shortcuts_path) || !fs::exists(entry.edges_path)) continue;
+
+        std::string name = dir.path().filename().string();
+        entry.has_bounds = cached_edges_bounds(entry.edges_path, entry.bounds);
+        std::cout << "Registered dataset " << name << (entry.has_bounds ? "" : " (no bounds)") << std::endl;
+        register_catalog_entry(name, entry);
+    }
+}
+
+std::string RoutingEngine::resolve_dataset(double start_lat, double start_lng,
+                                           double end_lat, double end_lng) const {
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+    std::vector<std::pair<Box, std::string>> hits;
+    catalog_index_.query(bgi::covers(Point(start_lng, start_lat)), std::back_inserter(hits));
+
+    // Prefer datasets covering both ends, then the smallest area
+    std::string best;
+    bool best_covers_end = false;
+    double best_area = 0.0;
+    for (const auto& [box, name] : hits) {
+        bool covers_end = bg::covered_by(Point(end_lng, end_lat), box);
+        double area = bg::area(box);
+        if (best.empty() || (covers_end && !best_covers_end) ||
+            (covers_end == best_covers_end && area < best_area)) {
+            best = name;
+            best_covers_end = covers_end;
+            best_area = area;
+        }
+    }
+    return best;
+}
+
+size_t RoutingEngine::memory_used_bytes() const {
+    std::shared_lock lock(datasets_mutex_);
+    size_t used = 0;
+    for (const auto& [name, dataset] : datasets_) used += dataset->memory_bytes;
+    return used;
 }
 
 std::vector<std::string> RoutingEngine::get_loaded_datasets() const {
+    std::shared_lock lock(datasets_mutex_);
     std::vector<std::string> names;
     for (const auto& pair : datasets_) {
         names.push_back(pair.first);
@@ -194,6 +665,291 @@ std::vector<std::string> RoutingEngine::get_loaded_datasets() const {
     return names;
 }
 
+void RoutingEngine::configure_expansion_cache(size_t budget_bytes, uint32_t pin_hits) {
+    expansion_cache_bytes_ = budget_bytes;
+    expansion_cache_pin_hits_ = pin_hits;
+}
+
+void RoutingEngine::configure_shared_memory(bool enabled, bool persistent) {
+    shared_memory_ = enabled;
+    shared_memory_persistent_ = persistent;
+    // Segments whose last user crashed have nobody left to remove them
+    if (enabled && !persistent) SharedDatasetSegment::remove_unused();
+}
+
+nlohmann::json RoutingEngine::get_profile_stats() const {
+    return profile_stats_.to_json();
+}
+
+nlohmann::json RoutingEngine::get_stats() const {
+    std::shared_lock lock(datasets_mutex_);
+    nlohmann::json stats = nlohmann::json::object();
+    for (const auto& [name, dataset] : datasets_) {
+        stats[name]["memory_bytes"] = dataset->memory_bytes;
+        stats[name]["last_used"] = dataset->last_used.load();
+        stats[name]["expansion_cache"] = dataset->metric.load()->expansion_cache->stats();
+        if (dataset->shared) {
+            stats[name]["shared_memory"] = {
+                {"segment", dataset->shared->name()},
+                {"bytes", dataset->shared->size_bytes()},
+                {"created", dataset->shared->created()}
+            };
+        }
+    }
+    return stats;
+}
+
+void RoutingEngine::configure_candidate_pruning(bool enabled, double max_speed_mps) {
+    prune_candidates_ = enabled;
+    prune_max_speed_mps_ = max_speed_mps;
+}
+
+nlohmann::json RoutingEngine::get_pruning_stats() const {
+    uint64_t kept = seeds_kept_.load();
+    uint64_t pruned = seeds_pruned_.load();
+    return {
+        {"enabled", prune_candidates_},
+        {"queries", pruned_queries_.load()},
+        {"seeds_kept", kept},
+        {"seeds_pruned", pruned},
+        {"pruned_ratio", kept + pruned ? static_cast<double>(pruned) / (kept + pruned) : 0.0}
+    };
+}
+
+// Overrides name edges by their original ids; unknown ids are dropped
+static std::vector<std::pair<uint32_t, double>> to_internal_overrides(
+    const RoutingEngine::Dataset& dataset,
+    const std::vector<std::pair<uint32_t, double>>& overrides
+) {
+    if (!dataset.ordering) return overrides;
+    std::vector<std::pair<uint32_t, double>> internal;
+    internal.reserve(overrides.size());
+    for (const auto& [edge, cost] : overrides) {
+        uint32_t id = dataset.ordering->to_internal(edge);
+        if (id != EdgeOrdering::UNKNOWN) internal.push_back({id, cost});
+    }
+    return internal;
+}
+
+nlohmann::json RoutingEngine::update_weights(
+    const std::string& dataset_name,
+    const std::vector<std::pair<uint32_t, double>>& overrides,
+    bool reset,
+    int threads
+) {
+    try {
+        auto dataset = acquire_dataset(dataset_name);
+        if (!dataset) {
+            return {{"error", "Dataset not loaded"}, {"success", false}};
+        }
+        std::lock_guard<std::mutex> lock(dataset->metric_mutex);
+
+        using clock = std::chrono::high_resolution_clock;
+        auto t1 = clock::now();
+        if (!dataset->customizer) {
+            std::cout << "Building metric customizer for " << dataset_name << std::endl;
+            dataset->customizer = std::make_unique<MetricCustomizer>(dataset->shortcuts_path);
+            {
+                std::unique_lock lock(datasets_mutex_);
+                dataset->memory_bytes += dataset->customizer->memory_bytes();
+            }
+            evict_to_budget(dataset_name);
+        }
+        auto internal_overrides = to_internal_overrides(*dataset, overrides);
+        auto update = dataset->customizer->apply(internal_overrides, reset, threads);
+        dataset->overridden = !internal_overrides.empty() || (!reset && dataset->overridden);
+        auto t2 = clock::now();
+
+        // Fastest overridden edge, checked against the seed pruning speed bound
+        auto current = dataset->metric.load();
+        double max_speed = reset ? 0.0 : current->max_override_speed_mps;
+        for (const auto& [edge, cost] : internal_overrides) {
+            const auto* geom = dataset->find_geometry(edge);
+            if (!geom) continue;
+            max_speed = std::max(max_speed, cost > 0.0 ? geom->length_m / cost
+                                                       : std::numeric_limits<double>::infinity());
+        }
+
+        // ShortcutGraph only builds from files, so the customized table goes
+        // through a temporary parquet into a fresh graph; geometry and spatial
+        // index are shared. The old graph stays resident until queries that
+        // hold it finish, so the new one is counted against the budget while
+        // it is built. Spans cached under the old via edges are stale once a
+        // via moves.
+        bool rows_changed = !dataset->customizer->changed_rows().empty();
+        if (rows_changed || max_speed != current->max_override_speed_mps) {
+            auto next = std::make_shared<Dataset::Metric>(*current);
+            if (rows_changed) {
+                size_t graph_bytes = dataset->customizer->costs().size() * GRAPH_BYTES_PER_SHORTCUT +
+                                     dataset->edge_count() * GRAPH_BYTES_PER_EDGE;
+                {
+                    std::unique_lock lock(datasets_mutex_);
+                    dataset->memory_bytes += graph_bytes;
+                }
+                evict_to_budget(dataset_name);
+                auto tmp_path = fs::temp_directory_path() /
+                    ("routing_weights_" + std::to_string(getpid()) + "_" +
+                     std::to_string(weights_file_counter_++) + ".parquet");
+                std::shared_ptr<ShortcutGraph> graph;
+                std::exception_ptr error;
+                try {
+                    dataset->customizer->write(tmp_path.string());
+                    graph = std::make_shared<ShortcutGraph>();
+                    graph->load_shortcuts(tmp_path.string());
+                    graph->load_edge_metadata(dataset->edges_path);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::error_code ec;
+                fs::remove(tmp_path, ec);
+                {
+                    std::unique_lock lock(datasets_mutex_);
+                    dataset->memory_bytes -= graph_bytes;
+                }
+                if (error) std::rethrow_exception(error);
+                next->graph = graph;
+            }
+            if (update.vias_changed > 0) {
+                next->expansion_cache =
+                    std::make_shared<ShortcutExpansionCache>(expansion_cache_bytes_, expansion_cache_pin_hits_);
+            }
+            next->max_override_speed_mps = max_speed;
+            dataset->metric.store(std::move(next));
+        }
+        auto t3 = clock::now();
+
+        return {
+            {"success", true},
+            {"dataset", dataset_name},
+            {"overrides", update.overrides},
+            {"base_shortcuts_updated", update.base_updated},
+            {"shortcuts_updated", update.shortcuts_updated},
+            {"vias_changed", update.vias_changed},
+            {"levels", update.levels},
+            {"customize_us", std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()},
+            {"publish_us", std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count()}
+        };
+    } catch (const std::exception& e) {
+        return {
+            {"success", false},
+            {"error", std::string("Weight update failed: ") + e.what()}
+        };
+    }
+}
+
+// Unpack each consecutive (from, to) pair of the path separately so popular
+// shortcuts are expanded once and then copied from the cache. Each segment
+// starts with `from` and ends with `to`; the shared edge is appended once.
+bool RoutingEngine::expand_path_cached(
+    const Dataset::Metric& metric,
+    const std::vector<uint32_t>& path,
+    std::vector<uint32_t>& base_edges
+) {
+    const auto& graph = *metric.graph;
+    base_edges.clear();
+    auto expand_uncached = [&]() {
+        auto expanded = graph.expand_shortcut_path(path);
+        base_edges = expanded.base_edges;
+        return expanded.success;
+    };
+    if (path.size() < 2) return expand_uncached();
+
+    auto& cache = *metric.expansion_cache;
+    for (size_t i = 0; i + 1 < path.size(); ++i) {
+        size_t skip = i == 0 ? 0 : 1;
+        if (cache.append(path[i], path[i + 1], base_edges, skip)) continue;
+
+        auto segment = graph.expand_shortcut_path({path[i], path[i + 1]});
+        if (!segment.success || segment.base_edges.empty() ||
+            segment.base_edges.front() != path[i] || segment.base_edges.back() != path[i + 1]) {
+            // Does not stitch; unpack the whole path the old way
+            return expand_uncached();
+        }
+        cache.insert(path[i], path[i + 1], segment.base_edges);
+        base_edges.insert(base_edges.end(), segment.base_edges.begin() + skip, segment.base_edges.end());
+    }
+    return true;
+}
+
+// Bounding box of an edge's polyline (x = lon, y = lat); inverse if unknown
+static Box edge_box(const RoutingEngine::Dataset& dataset, uint32_t edge_id) {
+    Box box;
+    bg::assign_inverse(box);
+    const auto* geom = dataset.find_geometry(edge_id);
+    if (!geom) return box;
+    for (uint32_t i = 0; i < geom->count; ++i) {
+        const auto& p = dataset.geometry_points[geom->offset + i];
+        bg::expand(box, Point(p.second, p.first));
+    }
+    return box;
+}
+
+// Lower bound in meters on the distance between two boxes. Degrees are
+// converted with the smallest meters-per-degree over the boxes' latitudes.
+static double box_gap_m(const Box& a, const Box& b) {
+    if (a.min_corner().get<0>() > a.max_corner().get<0>() ||
+        b.min_corner().get<0>() > b.max_corner().get<0>()) {
+        return 0.0;
+    }
+    constexpr double METERS_PER_DEG_LAT_MIN = 110574.0; // at the equator
+    constexpr double METERS_PER_DEG_LON_EQUATOR = 111319.0;
+    double dlon = std::max({0.0, a.min_corner().get<0>() - b.max_corner().get<0>(),
+                            b.min_corner().get<0>() - a.max_corner().get<0>()});
+    double dlat = std::max({0.0, a.min_corner().get<1>() - b.max_corner().get<1>(),
+                            b.min_corner().get<1>() - a.max_corner().get<1>()});
+    double max_abs_lat = std::max({std::abs(a.min_corner().get<1>()), std::abs(a.max_corner().get<1>()),
+                                   std::abs(b.min_corner().get<1>()), std::abs(b.max_corner().get<1>())});
+    double x = dlon * METERS_PER_DEG_LON_EQUATOR * std::cos(max_abs_lat * M_PI / 180.0);
+    double y = dlat * METERS_PER_DEG_LAT_MIN;
+    return std::sqrt(x * x + y * y);
+}
+
+// Drop seeds whose best possible total exceeds upper_bound. The total of a
+// (source, target) pair is at least source cost + target cost + the network
+// lower bound: box gap / max_speed_mps (0 when max_speed_mps is 0). The
+// optimal pair totals at most upper_bound, so both its seeds survive.
+static void prune_dominated_seeds(const RoutingEngine::Dataset& dataset, double upper_bound, double max_speed_mps,
+                                  std::vector<uint32_t>& sources, std::vector<double>& source_costs,
+                                  std::vector<uint32_t>& targets, std::vector<double>& target_costs,
+                                  RoutingEngine::CandidatePruning& stats) {
+    const size_t n = sources.size();
+    const size_t m = targets.size();
+    const double limit = upper_bound + 1e-9 * std::max(1.0, std::abs(upper_bound));
+    std::vector<Box> target_boxes(m);
+    if (max_speed_mps > 0.0) {
+        for (size_t j = 0; j < m; ++j) target_boxes[j] = edge_box(dataset, targets[j]);
+    }
+
+    std::vector<char> keep_source(n, 0), keep_target(m, 0);
+    for (size_t i = 0; i < n; ++i) {
+        Box source_box;
+        if (max_speed_mps > 0.0) source_box = edge_box(dataset, sources[i]);
+        for (size_t j = 0; j < m; ++j) {
+            double network = max_speed_mps > 0.0 ? box_gap_m(source_box, target_boxes[j]) / max_speed_mps : 0.0;
+            if (source_costs[i] + network + target_costs[j] <= limit) {
+                keep_source[i] = 1;
+                keep_target[j] = 1;
+            }
+        }
+    }
+
+    auto compact = [](std::vector<uint32_t>& edges, std::vector<double>& costs, const std::vector<char>& keep) {
+        size_t kept = 0;
+        for (size_t i = 0; i < edges.size(); ++i) {
+            if (!keep[i]) continue;
+            edges[kept] = edges[i];
+            costs[kept] = costs[i];
+            ++kept;
+        }
+        size_t pruned = edges.size() - kept;
+        edges.resize(kept);
+        costs.resize(kept);
+        return pruned;
+    };
+    stats.sources_pruned = compact(sources, source_costs, keep_source);
+    stats.targets_pruned = compact(targets, target_costs, keep_target);
+}
+
 // Helper to separate implementation
 std::vector<std::pair<uint32_t, double>> RoutingEngine::find_nearest_edges_internal(
     const Dataset& dataset,
@@ -201,29 +957,153 @@ std::vector<std::pair<uint32_t, double>> RoutingEngine::find_nearest_edges_inter
     double radius_meters,
     int max_candidates
 ) {
+    if (dataset.spatial_backend == SpatialBackend::H3Buckets) {
+        return find_nearest_edges_h3(dataset, lat, lng, radius_meters, max_candidates);
+    }
+
     std::vector<std::pair<uint32_t, double>> results;
-    
+    if (max_candidates <= 0) return results;
+    const size_t k = static_cast<size_t>(max_candidates);
+
     // Convert meters to degrees approx
     double radius_deg = radius_meters / 111320.0;
     
     Box box(Point(lng - radius_deg, lat - radius_deg), 
             Point(lng + radius_deg, lat + radius_deg));
-            
-    std::vector<Value> rtree_results;
-    dataset.rtree.query(bgi::intersects(box) && bgi::nearest(Point(lng, lat), max_candidates), 
-                        std::back_inserter(rtree_results));
-                        
-    for (const auto& res : rtree_results) {
-        // Calculate simpler distance (from point to box)
-        // Note: Coordinates are Lat/Lon but stored as Cartesian in R-tree.
-        // Result is Euclidean distance in degrees.
-        double dist_deg = bg::distance(Point(lng, lat), res.first);
-        
-        // Convert degrees to meters (approximate)
-        double dist_meters = dist_deg * 111320.0;
-        
-        results.push_back({res.second, dist_meters});
+
+    // Boxes come out nearest first. No point of a polyline is closer than
+    // its box, and the kernel's projection stretches a degree to at least
+    // kx meters, so once a box lies beyond the k-th best polyline no later
+    // edge can make the top k. Polylines are scored in batches for the
+    // vector kernel; results stay sorted by distance.
+    const Point query(lng, lat);
+    const double kx = 111320.0 * std::cos(lat * M_PI / 180.0);
+    std::vector<uint32_t> batch_ids;
+    std::vector<PolylineRef> batch_polylines;
+    std::vector<double> batch_dist;
+    auto score_batch = [&]() {
+        batch_dist.resize(batch_polylines.size());
+        point_polylines_distance_m(lat, lng, batch_polylines.data(), batch_polylines.size(), batch_dist.data());
+        for (size_t i = 0; i < batch_ids.size(); ++i) {
+            if (results.size() == k && batch_dist[i] >= results.back().second) continue;
+            auto pos = std::upper_bound(results.begin(), results.end(), batch_dist[i],
+                                        [](double d, const auto& r) { return d < r.second; });
+            results.insert(pos, {batch_ids[i], batch_dist[i]});
+            if (results.size() > k) results.pop_back();
+        }
+        batch_ids.clear();
+        batch_polylines.clear();
+    };
+    auto visit = [&](const Value& value) {
+        double bound_m = kx * bg::distance(query, value.first);
+        if (results.size() == k && bound_m > results.back().second) return false;
+        const auto* geom = dataset.find_geometry(value.second);
+        if (!geom) return true;
+        batch_ids.push_back(value.second);
+        batch_polylines.push_back({&dataset.geometry_points[geom->offset], geom->count});
+        if (batch_ids.size() == NEAREST_SCORE_BATCH) score_batch();
+        return true;
+    };
+    if (dataset.shared) {
+        unsigned count = static_cast<unsigned>(dataset.shared->rtree_size());
+        dataset.shared->query_until(bgi::intersects(box) && bgi::nearest(query, count), visit);
+    } else {
+        auto predicates = bgi::intersects(box) && bgi::nearest(query, static_cast<unsigned>(dataset.rtree.size()));
+        for (auto it = dataset.rtree.qbegin(predicates); it != dataset.rtree.qend(); ++it) {
+            if (!visit(*it)) break;
+        }
     }
+    score_batch();
+    return results;
+}
+
+// H3 bucket lookup: scan k-rings around the query cell outward until
+// max_candidates are found and no closer edge can appear in a further ring.
+std::vector<std::pair<uint32_t, double>> RoutingEngine::find_nearest_edges_h3(
+    const Dataset& dataset,
+    double lat, double lng,
+    double radius_meters,
+    int max_candidates
+) {
+    std::vector<std::pair<uint32_t, double>> results;
+    const auto& buckets = dataset.h3_buckets;
+    if (max_candidates <= 0 || buckets.cells.empty()) return results;
+
+    // Cells in ring k+1 have centers at least 1.5 * (k+1) edges from the
+    // origin, so any point in them is at least (1.5k - 0.5) edges from the
+    // query point. Cell sizes vary across the globe, so the edge comes from
+    // the origin cell's area rather than the resolution average. Polylines
+    // are bucketed by samples every half average edge, so a point of an edge
+    // inside a cell it only clips lies within a quarter average edge of a
+    // bucketed cell; the bound gives up that much to stay exact.
+    uint64_t origin = h3_lat_lng_to_cell(lat, lng, buckets.res);
+    double area_m2 = 0.0;
+    double edge_m = buckets.cell_edge_m;
+    if (cellAreaM2(origin, &area_m2) == 0 && area_m2 > 0.0) {
+        edge_m = std::sqrt(2.0 * area_m2 / (3.0 * std::sqrt(3.0))); // Regular hexagon
+    }
+    const double slack_m = buckets.cell_edge_m / 4.0;
+    auto ring_lower_bound_m = [edge_m, slack_m](int k) { return (1.5 * k - 0.5) * edge_m - slack_m; };
+    // Rings needed to cover the radius, capped so a huge client radius
+    // cannot make one lookup scan arbitrarily far
+    int max_k = static_cast<int>(std::ceil((radius_meters + slack_m) / edge_m / 1.5 + 1.0 / 3.0));
+    max_k = std::clamp(max_k, 0, H3_MAX_RINGS);
+
+    std::vector<std::pair<double, uint32_t>> found; // (meters, edge id)
+    std::vector<uint32_t> seen;                      // sorted edge ids already scored
+    std::vector<uint32_t> ring_edges;
+    std::vector<uint32_t> batch_ids;
+    std::vector<PolylineRef> batch_polylines;
+    std::vector<double> batch_dist;
+    std::vector<H3Index> ring;
+    // Rings are generated one at a time, so a lookup that stops early never
+    // builds the outer ones
+    for (int k = 0; k <= max_k; ++k) {
+        ring.assign(k == 0 ? 1 : 6 * static_cast<size_t>(k), 0);
+        if (gridRing(origin, k, ring.data()) != 0) break;
+        ring_edges.clear();
+        for (H3Index cell : ring) {
+            if (cell == 0) continue; // Pentagon distortion leaves gaps
+            auto it = buckets.cells.find(cell);
+            if (it == buckets.cells.end()) continue;
+            for (uint32_t e = it->second.first; e < it->second.second; ++e) {
+                ring_edges.push_back(buckets.entries[e].second);
+            }
+        }
+
+        // Edges span several cells; score each one once, the whole ring in
+        // one call of the batched kernel
+        std::sort(ring_edges.begin(), ring_edges.end());
+        ring_edges.erase(std::unique(ring_edges.begin(), ring_edges.end()), ring_edges.end());
+        batch_ids.clear();
+        batch_polylines.clear();
+        for (uint32_t edge_id : ring_edges) {
+            if (std::binary_search(seen.begin(), seen.end(), edge_id)) continue;
+            const auto* geom = dataset.find_geometry(edge_id);
+            if (!geom) continue;
+            batch_ids.push_back(edge_id);
+            batch_polylines.push_back({&dataset.geometry_points[geom->offset], geom->count});
+        }
+        batch_dist.resize(batch_ids.size());
+        point_polylines_distance_m(lat, lng, batch_polylines.data(), batch_polylines.size(), batch_dist.data());
+        for (size_t i = 0; i < batch_ids.size(); ++i) {
+            if (batch_dist[i] <= radius_meters) found.push_back({batch_dist[i], batch_ids[i]});
+        }
+        size_t old_seen = seen.size();
+        seen.insert(seen.end(), ring_edges.begin(), ring_edges.end());
+        std::inplace_merge(seen.begin(), seen.begin() + old_seen, seen.end());
+        seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+
+        // Stop once the k-th best beats anything ring k+1 could add
+        std::sort(found.begin(), found.end());
+        if (static_cast<int>(found.size()) >= max_candidates &&
+            found[max_candidates - 1].first <= ring_lower_bound_m(k)) {
+            break;
+        }
+    }
+
+    if (static_cast<int>(found.size()) > max_candidates) found.resize(max_candidates);
+    for (const auto& f : found) results.push_back({f.second, f.first});
     return results;
 }
 
@@ -234,10 +1114,90 @@ std::vector<std::pair<uint32_t, double>> RoutingEngine::find_nearest_edges(
     double radius,
     int max_candidates
 ) {
-    auto it = datasets_.find(dataset_name);
-    if (it == datasets_.end()) return {};
+    auto dataset = acquire_dataset(dataset_name);
+    if (!dataset) return {};
     
-    return find_nearest_edges_internal(it->second, lat, lng, radius, max_candidates);
+    auto results = find_nearest_edges_internal(*dataset, lat, lng, radius, max_candidates);
+    for (auto& result : results) result.first = dataset->external_id(result.first);
+    return results;
+}
+
+// Batch lookup: points are visited in Hilbert order so consecutive R-tree
+// descents touch the same (cache-hot) nodes, in contiguous chunks per thread.
+// Results come back in input order.
+std::vector<std::vector<std::pair<uint32_t, double>>> RoutingEngine::find_nearest_edges_batch(
+    const std::string& dataset_name,
+    const std::vector<std::pair<double, double>>& points,
+    double radius,
+    int max_candidates,
+    int threads
+) {
+    std::vector<std::vector<std::pair<uint32_t, double>>> results(points.size());
+    auto dataset = acquire_dataset(dataset_name);
+    if (!dataset || points.empty()) return results;
+
+    const Box& bounds = dataset->bounds;
+    double min_lon = bounds.min_corner().get<0>(), min_lat = bounds.min_corner().get<1>();
+    double span_lon = std::max(bounds.max_corner().get<0>() - min_lon, 1e-9);
+    double span_lat = std::max(bounds.max_corner().get<1>() - min_lat, 1e-9);
+    auto to_grid = [](double t) {
+        return static_cast<uint32_t>(std::clamp(t, 0.0, 1.0) * 65535.0);
+    };
+
+    std::vector<std::pair<uint64_t, uint32_t>> order(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        uint32_t x = to_grid((points[i].second - min_lon) / span_lon);
+        uint32_t y = to_grid((points[i].first - min_lat) / span_lat);
+        order[i] = {hilbert_index(x, y), static_cast<uint32_t>(i)};
+    }
+    std::sort(order.begin(), order.end());
+
+    auto worker = [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            uint32_t i = order[k].second;
+            results[i] = find_nearest_edges_internal(*dataset, points[i].first, points[i].second,
+                                                     radius, max_candidates);
+            for (auto& result : results[i]) result.first = dataset->external_id(result.first);
+        }
+    };
+
+    // The calling (request) thread takes the first chunk; helpers are
+    // reserved from the allowance up front and handed back once joined
+    int helpers = 0;
+    if (points.size() >= BATCH_INLINE_POINTS) {
+        int wanted = static_cast<int>(std::min<size_t>(
+            std::max(threads, 1), points.size() / BATCH_MIN_POINTS_PER_THREAD)) - 1;
+        int free = batch_helpers_free_.load();
+        while (wanted > 0 && free > 0) {
+            int take = std::min(wanted, free);
+            if (batch_helpers_free_.compare_exchange_weak(free, free - take)) {
+                helpers = take;
+                break;
+            }
+        }
+    }
+    if (helpers == 0) {
+        worker(0, points.size());
+        return results;
+    }
+    size_t workers = static_cast<size_t>(helpers) + 1;
+    size_t chunk = (points.size() + workers - 1) / workers;
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < workers; ++w) {
+        size_t begin = w * chunk;
+        size_t end = std::min(points.size(), begin + chunk);
+        if (begin < end) pool.emplace_back(worker, begin, end);
+    }
+    std::exception_ptr error;
+    try {
+        worker(0, std::min(points.size(), chunk));
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (auto& t : pool) t.join();
+    batch_helpers_free_ += helpers;
+    if (error) std::rethrow_exception(error);
+    return results;
 }
 
 // Find single nearest edge
@@ -257,14 +1217,23 @@ nlohmann::json RoutingEngine::compute_route(
     double end_lat, double end_lng,
     double search_radius,
     int max_candidates,
-    const std::string& mode
+    const std::string& mode,
+    bool profile,
+    RouteOutput output
 ) {
     try {
-        auto it = datasets_.find(dataset_name);
-        if (it == datasets_.end()) {
+        RequestProfiler profiler(profile);
+
+        // Lookup, plus the whole load when lazy loading brings the dataset in
+        profiler.begin("acquire");
+        auto dataset_ptr = acquire_dataset(dataset_name);
+        profiler.end();
+        if (!dataset_ptr) {
             return {{"error", "Dataset not loaded"}, {"success", false}};
         }
-        const auto& dataset = it->second;
+        const auto& dataset = *dataset_ptr;
+        auto metric = dataset.metric.load();
+        const auto& graph = metric->graph;
 
         // Timers
         std::cout << "[DEBUG] Routing Engine v2 - Exposed Debug Info" << std::endl;
@@ -275,13 +1244,16 @@ nlohmann::json RoutingEngine::compute_route(
         std::vector<std::pair<uint32_t, double>> end_results;
         long time_nearest_us = 0;
         long time_search_us = 0;
+        nlohmann::json pruning_info;
 
         if (mode == "one_to_one") {
              // 1. Find Nearest Edge (One-to-One)
+            profiler.begin("find_nearest");
             auto t1 = clock::now();
             start_results = find_nearest_edges_internal(dataset, start_lat, start_lng, search_radius, 1);
             end_results = find_nearest_edges_internal(dataset, end_lat, end_lng, search_radius, 1);
             auto t2 = clock::now();
+            profiler.end();
             time_nearest_us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
             if (start_results.empty() || end_results.empty()) {
@@ -291,13 +1263,14 @@ nlohmann::json RoutingEngine::compute_route(
             std::cout << "[OneToOne] Start Edge: " << start_results[0].first << " End Edge: " << end_results[0].first << std::endl;
 
             // 2. Run Query using one-to-one algorithm with hierarchical filtering (explicit run_bidirectional)
+            profiler.begin("search");
             auto t3 = clock::now();
             
             uint32_t start_edge = start_results[0].first;
             uint32_t end_edge = end_results[0].first;
 
             // Explicitly compute High Cell and Context
-            ShortcutGraph::HighCell high_cell = dataset.graph.compute_high_cell(start_edge, end_edge);
+            ShortcutGraph::HighCell high_cell = graph->compute_high_cell(start_edge, end_edge);
             
             std::cout << "[OneToOne] High Cell: " << high_cell.cell 
                       << " Resolution: " << high_cell.res << std::endl;
@@ -305,9 +1278,10 @@ nlohmann::json RoutingEngine::compute_route(
             ShortcutGraph::QueryContext ctx;
             ctx.high_cell = high_cell;
 
-            result = dataset.graph.run_bidirectional(start_edge, end_edge, ctx);
+            result = graph->run_bidirectional(start_edge, end_edge, ctx);
             
             auto t4 = clock::now();
+            profiler.end();
             time_search_us = std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count();
             
             // Add approach and egress times
@@ -320,10 +1294,12 @@ nlohmann::json RoutingEngine::compute_route(
 
         } else {
             // 1. Find Nearest Edges (Many-to-Many)
+            profiler.begin("find_nearest");
             auto t1 = clock::now();
             start_results = find_nearest_edges_internal(dataset, start_lat, start_lng, search_radius, max_candidates);
             end_results = find_nearest_edges_internal(dataset, end_lat, end_lng, search_radius, max_candidates);
             auto t2 = clock::now();
+            profiler.end();
             time_nearest_us = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
 
             if (start_results.empty() || end_results.empty()) {
@@ -331,6 +1307,7 @@ nlohmann::json RoutingEngine::compute_route(
             }
 
             // 2. Run Query - Use query_multi_optimized for all KNN queries
+            profiler.begin("search");
             auto t3 = clock::now();
             
             // Prepare for query_multi_optimized
@@ -352,8 +1329,43 @@ nlohmann::json RoutingEngine::compute_route(
                 target_dists.push_back(res.second / ASSUMED_SPEED_MPS);
             }
 
-            result = dataset.graph.query_multi_optimized(source_edges, target_edges, source_dists, target_dists);
+            // Drop seeds that cannot beat the nearest pair even with the
+            // fastest possible network leg. The pilot search only pays off
+            // with many seed pairs, and the speed bound no longer holds
+            // once an override makes some edge faster than it.
+            bool searched = false;
+            bool bound_holds = prune_max_speed_mps_ <= 0.0 || metric->max_override_speed_mps <= prune_max_speed_mps_;
+            if (prune_candidates_ && bound_holds &&
+                source_edges.size() * target_edges.size() >= PRUNE_MIN_SEED_PAIRS) {
+                // Candidates come sorted by distance, so seed 0 is the nearest
+                QueryResult pilot = graph->query_multi_optimized(
+                    {source_edges[0]}, {target_edges[0]}, {source_dists[0]}, {target_dists[0]});
+                if (pilot.reachable) {
+                    CandidatePruning pruning;
+                    prune_dominated_seeds(dataset, pilot.distance, prune_max_speed_mps_,
+                                          source_edges, source_dists, target_edges, target_dists, pruning);
+                    // Only the pilot pair survived: its result is the answer
+                    if (source_edges.size() == 1 && target_edges.size() == 1) {
+                        result = pilot;
+                        searched = true;
+                    }
+                    pruning_info = {
+                        {"sources_kept", source_edges.size()},
+                        {"sources_pruned", pruning.sources_pruned},
+                        {"targets_kept", target_edges.size()},
+                        {"targets_pruned", pruning.targets_pruned},
+                        {"pilot_only", searched}
+                    };
+                    seeds_kept_ += source_edges.size() + target_edges.size();
+                    seeds_pruned_ += pruning.sources_pruned + pruning.targets_pruned;
+                    pruned_queries_ += 1;
+                }
+            }
+            if (!searched) {
+                result = graph->query_multi_optimized(source_edges, target_edges, source_dists, target_dists);
+            }
             auto t4 = clock::now();
+            profiler.end();
             time_search_us = std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count();
         }
 
@@ -361,50 +1373,83 @@ nlohmann::json RoutingEngine::compute_route(
             return {{"error", "No path found"}, {"success", false}};
         }
 
+        // Only the full output carries debug info
+        auto finish = [&](nlohmann::json response) {
+            if (output == RouteOutput::Full && !pruning_info.is_null()) {
+                response["debug"]["candidate_pruning"] = pruning_info;
+            }
+            if (profiler.enabled()) {
+                response["profile"] = profiler.to_json();
+                profile_stats_.record(profiler, dataset_name + "/" + mode);
+            }
+            return response;
+        };
+
+        // Cost only: no unpacking, geometry or debug info
+        if (output == RouteOutput::Distance) {
+            return finish({
+                {"success", true},
+                {"dataset", dataset_name},
+                {"route", {{"distance", result.distance}}},
+                {"timing_breakdown", {
+                    {"find_nearest_us", time_nearest_us},
+                    {"search_us", time_search_us}
+                }}
+            });
+        }
+
         // 3. Expand Path
+        profiler.begin("expand");
         auto t5 = clock::now();
-        auto expanded = dataset.graph.expand_shortcut_path(result.path);
+        std::vector<uint32_t> base_edges;
+        bool expanded = expand_path_cached(*metric, result.path, base_edges);
         auto t6 = clock::now();
+        profiler.end();
         auto time_expand_us = std::chrono::duration_cast<std::chrono::microseconds>(t6 - t5).count();
 
-        if (!expanded.success) {
+        if (!expanded) {
             return {{"error", "Failed to expand path"}, {"success", false}};
         }
 
-        // Helper for distance
-        auto haversine_distance = [](double lat1, double lon1, double lat2, double lon2) {
-            constexpr double R = 6371000.0;
-            double dLat = (lat2 - lat1) * M_PI / 180.0;
-            double dLon = (lon2 - lon1) * M_PI / 180.0;
-            lat1 = lat1 * M_PI / 180.0;
-            lat2 = lat2 * M_PI / 180.0;
-            double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
-                       std::sin(dLon / 2) * std::sin(dLon / 2) * std::cos(lat1) * std::cos(lat2);
-            double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
-            return R * c;
-        };
+        std::vector<uint32_t> external_path(base_edges.size());
+        for (size_t i = 0; i < base_edges.size(); ++i) external_path[i] = dataset.external_id(base_edges[i]);
+
+        // Base-edge path: lengths come from the precomputed table, no geometry walk
+        if (output == RouteOutput::Edges) {
+            double length_meters = 0.0;
+            for (uint32_t edge_id : base_edges) {
+                if (const auto* geom = dataset.find_geometry(edge_id)) length_meters += geom->length_m;
+            }
+            return finish({
+                {"success", true},
+                {"dataset", dataset_name},
+                {"route", {
+                    {"distance", result.distance},
+                    {"distance_meters", length_meters},
+                    {"path", external_path}
+                }},
+                {"timing_breakdown", {
+                    {"find_nearest_us", time_nearest_us},
+                    {"search_us", time_search_us},
+                    {"expand_us", time_expand_us}
+                }}
+            });
+        }
 
-        // 4. Build GeoJSON and Calculate Distance
+        // 4. Build GeoJSON and sum precomputed edge lengths
+        profiler.begin("geojson");
         auto t7 = clock::now();
         nlohmann::json coordinates = nlohmann::json::array();
         double total_distance_meters = 0.0;
         
-        for (const auto& edge_id : expanded.base_edges) {
-            auto geom_it = dataset.edge_geometries.find(edge_id);
-            if (geom_it != dataset.edge_geometries.end()) {
-                const auto& points = geom_it->second;
-                if (points.empty()) continue;
+        for (const auto& edge_id : base_edges) {
+            if (const auto* geom = dataset.find_geometry(edge_id)) {
+                total_distance_meters += geom->length_m;
 
-                for (size_t i = 0; i < points.size(); ++i) {
+                for (uint32_t i = 0; i < geom->count; ++i) {
                     // p is {lat, lon}, GeoJSON needs [lon, lat]
-                    coordinates.push_back({points[i].second, points[i].first});
-                    
-                    if (i > 0) {
-                        total_distance_meters += haversine_distance(
-                            points[i-1].first, points[i-1].second,
-                            points[i].first, points[i].second
-                        );
-                    }
+                    const auto& p = dataset.geometry_points[geom->offset + i];
+                    coordinates.push_back({p.second, p.first});
                 }
             }
         }
@@ -421,6 +1466,7 @@ nlohmann::json RoutingEngine::compute_route(
             }}
         };
         auto t8 = clock::now();
+        profiler.end();
         auto time_geojson_us = std::chrono::duration_cast<std::chrono::microseconds>(t8 - t7).count();
 
         nlohmann::json response = {
@@ -429,7 +1475,7 @@ nlohmann::json RoutingEngine::compute_route(
             {"route", {
                 {"distance", result.distance},         // Time/Cost
                 {"distance_meters", total_distance_meters}, // Physical Distance
-                {"path", expanded.base_edges},
+                {"path", external_path},
                 {"geojson", geojson}
             }},
             {"timing_breakdown", {
@@ -447,16 +1493,17 @@ nlohmann::json RoutingEngine::compute_route(
         };
 
         // Populate cell visualization (for ALL modes if path exists)
-        if (!expanded.base_edges.empty()) {
-            uint32_t s_edge = expanded.base_edges.front();
-            uint32_t t_edge = expanded.base_edges.back();
+        profiler.begin("debug");
+        if (!base_edges.empty()) {
+            uint32_t s_edge = base_edges.front();
+            uint32_t t_edge = base_edges.back();
             
             // Recompute high cell for visualization
-            ShortcutGraph::HighCell high = dataset.graph.compute_high_cell(s_edge, t_edge);
+            ShortcutGraph::HighCell high = graph->compute_high_cell(s_edge, t_edge);
             
             // Helper: Resolve cell for edge
             auto resolve_cell = [&](uint32_t edge, double lat, double lng) -> std::pair<uint64_t, int> {
-                auto meta = dataset.graph.get_edge_meta(edge);
+                auto meta = graph->get_edge_meta(edge);
                 uint64_t cell = meta.incoming_cell;
                 if (cell == 0) cell = meta.outgoing_cell;
                 
@@ -502,11 +1549,11 @@ nlohmann::json RoutingEngine::compute_route(
         }
 
         // Populate shortcut debug info
-        auto shortcuts_debug = dataset.graph.get_path_debug_info(result.path);
+        auto shortcuts_debug = graph->get_path_debug_info(result.path);
         for (const auto& sc : shortcuts_debug) {
             response["debug"]["shortcuts"].push_back({
-                {"from", sc.from},
-                {"to", sc.to},
+                {"from", dataset.external_id(sc.from)},
+                {"to", dataset.external_id(sc.to)},
                 {"cell", sc.cell},
                 {"res", sc.res}
             });
@@ -516,20 +1563,21 @@ nlohmann::json RoutingEngine::compute_route(
         const double DEBUG_SPEED = 13.89;
         for (const auto& kv : start_results) {
             response["debug"]["source_candidates"].push_back({
-                {"edge_id", kv.first},
+                {"edge_id", dataset.external_id(kv.first)},
                 {"dist_m", kv.second},
                 {"dist_s", kv.second / DEBUG_SPEED}
             });
         }
         for (const auto& kv : end_results) {
             response["debug"]["target_candidates"].push_back({
-                {"edge_id", kv.first},
+                {"edge_id", dataset.external_id(kv.first)},
                 {"dist_m", kv.second},
                 {"dist_s", kv.second / DEBUG_SPEED}
             });
         }
+        profiler.end();
 
-        return response;
+        return finish(std::move(response));
     } catch (const std::exception& e) {
         return {
             {"success", false},
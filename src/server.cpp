@@ -3,6 +3,8 @@
 #include <iostream>
 #include <sstream>
 #include <chrono> // Added for std::chrono
+#include <cmath>
+#include <random>
 
 RoutingServer::RoutingServer() : routing_engine_(std::make_unique<RoutingEngine>()) {
     // Setup routes
@@ -109,11 +111,21 @@ RoutingServer::RoutingServer() : routing_engine_(std::make_unique<RoutingEngine>
              return crow::response(500, response.dump());
         }
     });
+    // Route: Nearest edges for many points in one request
+    CROW_ROUTE(app_, "/nearest_edges/batch").methods("POST"_method)([this](const crow::request& req) {
+        return handle_nearest_edges_batch(req);
+    });
     // Route: Compute shortest path
     CROW_ROUTE(app_, "/health")([this]() { return handle_health_check(); });
+    CROW_ROUTE(app_, "/stats")([this]() { return handle_stats(); });
+    CROW_ROUTE(app_, "/debug/profile")([this]() {
+        return crow::response(200, routing_engine_->get_profile_stats().dump());
+    });
     CROW_ROUTE(app_, "/route").methods("POST"_method)([this](const crow::request& req) { return handle_route(req); });
+    CROW_ROUTE(app_, "/distance").methods("POST"_method)([this](const crow::request& req) { return handle_route(req, "distance"); });
     CROW_ROUTE(app_, "/load_dataset").methods("POST"_method)([this](const crow::request& req) { return handle_load_dataset(req); });
     CROW_ROUTE(app_, "/unload_dataset").methods("POST"_method)([this](const crow::request& req) { return handle_unload_dataset(req); });
+    CROW_ROUTE(app_, "/weights").methods("POST"_method)([this](const crow::request& req) { return handle_weights(req); });
 }
 
 void RoutingServer::load_config(const std::string& config_file) {
@@ -126,12 +138,32 @@ void RoutingServer::load_config(const std::string& config_file) {
             if (j.contains("port")) config_.port = j["port"];
             if (j.contains("host")) config_.host = j["host"];
             if (j.contains("thread_count")) config_.thread_count = j["thread_count"];
+            if (j.contains("max_batch_points")) config_.max_batch_points = j["max_batch_points"];
             if (j.contains("datasets_path")) config_.datasets_path = j["datasets_path"];
+            if (j.contains("spatial_index")) config_.spatial_index = j["spatial_index"];
+            if (j.contains("reorder_edges")) config_.reorder_edges = j["reorder_edges"];
+            if (j.contains("shared_memory")) config_.shared_memory = j["shared_memory"];
+            if (j.contains("shared_memory_persistent")) config_.shared_memory_persistent = j["shared_memory_persistent"];
+            if (j.contains("expansion_cache_bytes")) config_.expansion_cache_bytes = j["expansion_cache_bytes"];
+            if (j.contains("expansion_cache_pin_hits")) config_.expansion_cache_pin_hits = j["expansion_cache_pin_hits"];
+            if (j.contains("lazy_loading")) config_.lazy_loading = j["lazy_loading"];
+            if (j.contains("memory_budget_bytes")) config_.memory_budget_bytes = j["memory_budget_bytes"];
+            if (j.contains("coalesce_requests")) config_.coalesce_requests = j["coalesce_requests"];
+            if (j.contains("coalesce_precision")) config_.coalesce_precision = j["coalesce_precision"];
+            if (j.contains("prune_candidates")) config_.prune_candidates = j["prune_candidates"];
+            if (j.contains("prune_max_speed_mps")) config_.prune_max_speed_mps = j["prune_max_speed_mps"];
+            if (j.contains("profile_sample_percent")) config_.profile_sample_percent = j["profile_sample_percent"];
         }
     } catch (const std::exception& e) {
         std::cerr << "Warning: Could not load config file " << config_file << ": " << e.what() << std::endl;
         std::cerr << "Using default configuration." << std::endl;
     }
+    routing_engine_->configure_expansion_cache(config_.expansion_cache_bytes, config_.expansion_cache_pin_hits);
+    routing_engine_->configure_shared_memory(config_.shared_memory, config_.shared_memory_persistent);
+    routing_engine_->configure_candidate_pruning(config_.prune_candidates, config_.prune_max_speed_mps);
+    routing_engine_->configure_lazy_loading(config_.datasets_path, config_.lazy_loading,
+                                            config_.memory_budget_bytes, config_.spatial_index,
+                                            config_.reorder_edges);
 }
 
 void RoutingServer::run() {
@@ -142,28 +174,90 @@ void RoutingServer::run() {
 crow::response RoutingServer::handle_health_check() {
     nlohmann::json response = {
         {"status", "healthy"},
-        {"datasets_loaded", routing_engine_->get_loaded_datasets()}
+        {"datasets_loaded", routing_engine_->get_loaded_datasets()},
+        {"memory_bytes_used", routing_engine_->memory_used_bytes()},
+        {"memory_budget_bytes", routing_engine_->memory_budget_bytes()}
+    };
+    return crow::response(200, response.dump());
+}
+
+crow::response RoutingServer::handle_stats() {
+    nlohmann::json response = {
+        {"datasets", routing_engine_->get_stats()},
+        {"route_coalescing", route_coalescer_.stats()},
+        {"candidate_pruning", routing_engine_->get_pruning_stats()}
     };
     return crow::response(200, response.dump());
 }
 
-crow::response RoutingServer::handle_route(const crow::request& req) {
+crow::response RoutingServer::handle_route(const crow::request& req, const std::string& default_output) {
     try {
         auto json_body = nlohmann::json::parse(req.body);
 
-        std::string dataset = json_body["dataset"];
         double start_lat = json_body["start_lat"];
         double start_lng = json_body["start_lng"];
         double end_lat = json_body["end_lat"];
         double end_lng = json_body["end_lng"];
+
+        // Without a dataset, pick the one whose bounds cover the coordinates
+        std::string dataset = json_body.value("dataset", "");
+        if (dataset.empty()) {
+            dataset = routing_engine_->resolve_dataset(start_lat, start_lng, end_lat, end_lng);
+            if (dataset.empty()) {
+                nlohmann::json error_response = {
+                    {"success", false},
+                    {"error", "No dataset covers the requested coordinates"}
+                };
+                return crow::response(400, error_response.dump());
+            }
+        }
         double search_radius = json_body.value("search_radius", 1000.0);
         int max_candidates = json_body.value("max_candidates", json_body.value("num_candidates", 10));
         std::string mode = json_body.value("mode", "default");
+        std::string output_name = json_body.value("return", default_output);
+        RouteOutput output;
+        if (output_name == "full") {
+            output = RouteOutput::Full;
+        } else if (output_name == "edges") {
+            output = RouteOutput::Edges;
+        } else if (output_name == "distance") {
+            output = RouteOutput::Distance;
+        } else {
+            nlohmann::json error_response = {
+                {"success", false},
+                {"error", "Unknown return option: " + output_name + " (expected full, edges or distance)"}
+            };
+            return crow::response(400, error_response.dump());
+        }
+
+        // Profile on request, or for a sampled share of all routes
+        bool profile = json_body.value("profile", false);
+        if (!profile && config_.profile_sample_percent > 0.0) {
+            thread_local std::mt19937 rng(std::random_device{}());
+            profile = std::uniform_real_distribution<double>(0.0, 100.0)(rng) < config_.profile_sample_percent;
+        }
 
-        auto route = routing_engine_->compute_route(
-            dataset, start_lat, start_lng, end_lat, end_lng,
-            search_radius, max_candidates, mode
-        );
+        auto compute = [&]() {
+            return routing_engine_->compute_route(
+                dataset, start_lat, start_lng, end_lat, end_lng,
+                search_radius, max_candidates, mode, profile, output
+            );
+        };
+
+        // Identical requests in flight share one computation. Coordinates are
+        // rounded, so followers may get a route for a point up to ~1m away.
+        nlohmann::json route;
+        if (config_.coalesce_requests) {
+            double scale = std::pow(10.0, config_.coalesce_precision);
+            std::ostringstream key;
+            key << dataset << '|' << std::llround(start_lat * scale) << '|' << std::llround(start_lng * scale)
+                << '|' << std::llround(end_lat * scale) << '|' << std::llround(end_lng * scale)
+                << '|' << mode << '|' << search_radius << '|' << max_candidates << '|' << profile
+                << '|' << output_name;
+            route = route_coalescer_.run(key.str(), compute);
+        } else {
+            route = compute();
+        }
 
         nlohmann::json response = {
             {"success", true},
@@ -193,12 +287,17 @@ crow::response RoutingServer::handle_load_dataset(const crow::request& req) {
         
         if (json_body.contains("shortcuts_path")) shortcuts_path = json_body["shortcuts_path"];
         if (json_body.contains("edges_path")) edges_path = json_body["edges_path"];
+        std::string spatial_index = json_body.value("spatial_index", config_.spatial_index);
+        bool reorder_edges = json_body.value("reorder_edges", config_.reorder_edges);
 
-        bool success = routing_engine_->load_dataset(dataset, config_.datasets_path, shortcuts_path, edges_path);
+        bool success = routing_engine_->load_dataset(dataset, config_.datasets_path, shortcuts_path, edges_path,
+                                                     spatial_index, reorder_edges);
 
         nlohmann::json response = {
             {"success", success},
-            {"dataset", dataset}
+            {"dataset", dataset},
+            {"spatial_index", spatial_index},
+            {"reorder_edges", reorder_edges}
         };
 
         return crow::response(success ? 200 : 400, response.dump());
@@ -235,4 +334,84 @@ crow::response RoutingServer::handle_unload_dataset(const crow::request& req) {
         };
         return crow::response(400, error_response.dump());
     }
-}
\ No newline at end of file
+}
+
+crow::response RoutingServer::handle_weights(const crow::request& req) {
+    try {
+        auto json_body = nlohmann::json::parse(req.body);
+        std::string dataset = json_body["dataset"];
+        bool reset = json_body.value("reset", false);
+
+        std::vector<std::pair<uint32_t, double>> overrides;
+        if (json_body.contains("overrides")) {
+            for (const auto& item : json_body["overrides"]) {
+                overrides.push_back({item["edge_id"].get<uint32_t>(), item["cost"].get<double>()});
+            }
+        }
+
+        auto response = routing_engine_->update_weights(dataset, overrides, reset, config_.thread_count);
+        return crow::response(response["success"].get<bool>() ? 200 : 400, response.dump());
+
+    } catch (const std::exception& e) {
+        nlohmann::json error_response = {
+            {"success", false},
+            {"error", e.what()}
+        };
+        return crow::response(400, error_response.dump());
+    }
+}
+
+crow::response RoutingServer::handle_nearest_edges_batch(const crow::request& req) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    nlohmann::json response;
+    try {
+        auto body = nlohmann::json::parse(req.body);
+        std::string dataset_name = body.value("dataset", "");
+        double radius = body.value("radius", 1000.0);
+        int max_candidates = body.value("max_candidates", 5);
+
+        if (dataset_name.empty() || !body.contains("points") || !body["points"].is_array()) {
+            response["success"] = false;
+            response["error"] = "Missing dataset or points";
+            return crow::response(400, response.dump());
+        }
+        if (body["points"].size() > config_.max_batch_points) {
+            response["success"] = false;
+            response["error"] = "Batch of " + std::to_string(body["points"].size()) +
+                                " points exceeds max_batch_points (" + std::to_string(config_.max_batch_points) + ")";
+            return crow::response(413, response.dump());
+        }
+
+        // Points as [lat, lon] pairs or {"lat": .., "lon": ..} objects
+        std::vector<std::pair<double, double>> points;
+        points.reserve(body["points"].size());
+        for (const auto& p : body["points"]) {
+            if (p.is_array()) points.push_back({p[0].get<double>(), p[1].get<double>()});
+            else points.push_back({p["lat"].get<double>(), p["lon"].get<double>()});
+        }
+
+        auto batch = routing_engine_->find_nearest_edges_batch(
+            dataset_name, points, radius, max_candidates, config_.thread_count);
+
+        nlohmann::json results = nlohmann::json::array();
+        for (const auto& edges : batch) {
+            nlohmann::json edges_json = nlohmann::json::array();
+            for (const auto& e : edges) {
+                edges_json.push_back({{"id", e.first}, {"distance", e.second}});
+            }
+            results.push_back(std::move(edges_json));
+        }
+
+        response["success"] = true;
+        response["count"] = points.size();
+        response["results"] = std::move(results);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        response["runtime_ms"] = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() / 1000.0;
+        return crow::response(200, response.dump());
+
+    } catch (const std::exception& e) {
+        response["success"] = false;
+        response["error"] = e.what();
+        return crow::response(400, response.dump());
+    }
+}
@@ -0,0 +1,241 @@
+#include "shared_dataset.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace bip = boost::interprocess;
+namespace fs = std::filesystem;
+
+// Bump when the segment layout changes
+constexpr uint32_t SEGMENT_VERSION = 2;
+
+struct SharedDatasetSegment::Header {
+    uint32_t version = SEGMENT_VERSION;
+    SourceStamp stamp;
+    // Distinguishes a segment from a later one created under the same name
+    uint64_t generation = 0;
+    bool complete = false;
+};
+
+namespace {
+
+constexpr const char* USERS_SUFFIX = ".users";
+
+// Exclusive flock on <tmp>/<segment>.lock, serializing create, attach and
+// detach of one segment across processes. The kernel drops the lock when
+// its holder dies, so a crash mid-create cannot wedge later loads.
+class SegmentLock {
+public:
+    explicit SegmentLock(const std::string& name) {
+        auto path = (fs::temp_directory_path() / (name + ".lock")).string();
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd_ < 0) throw std::runtime_error("Cannot open " + path);
+        while (::flock(fd_, LOCK_EX) != 0) {
+            if (errno != EINTR) {
+                ::close(fd_);
+                throw std::runtime_error("Cannot lock " + path);
+            }
+        }
+    }
+    ~SegmentLock() { ::close(fd_); }
+    SegmentLock(const SegmentLock&) = delete;
+    SegmentLock& operator=(const SegmentLock&) = delete;
+
+private:
+    int fd_ = -1;
+};
+
+// Open <tmp>/<segment>.users; every generation of a segment shares it
+int open_users_file(const std::string& name) {
+    auto path = (fs::temp_directory_path() / (name + USERS_SUFFIX)).string();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    return fd;
+}
+
+// Shared lock marking this mapping as a user. Only taken under the segment
+// lock, and an exclusive holder releases its lock before that, so it does
+// not wait.
+int lock_users_file(const std::string& name) {
+    int fd = open_users_file(name);
+    while (::flock(fd, LOCK_SH) != 0) {
+        if (errno != EINTR) {
+            ::close(fd);
+            throw std::runtime_error("Cannot lock users file of " + name);
+        }
+    }
+    return fd;
+}
+
+// Remove the segment if no process maps any generation of it. The caller
+// holds the segment lock.
+bool remove_if_unused(const std::string& name) {
+    int fd = open_users_file(name);
+    bool removed = false;
+    if (::flock(fd, LOCK_EX | LOCK_NB) == 0) removed = bip::shared_memory_object::remove(name.c_str());
+    ::close(fd);
+    return removed;
+}
+
+} // namespace
+
+SharedDatasetSegment::SourceStamp SharedDatasetSegment::stamp(const std::string& shortcuts_path,
+                                                              const std::string& edges_path, bool reordered) {
+    SourceStamp s;
+    s.shortcuts_size = fs::file_size(shortcuts_path);
+    s.shortcuts_mtime = fs::last_write_time(shortcuts_path).time_since_epoch().count();
+    s.edges_size = fs::file_size(edges_path);
+    s.edges_mtime = fs::last_write_time(edges_path).time_since_epoch().count();
+    s.reordered = reordered;
+    return s;
+}
+
+std::string SharedDatasetSegment::segment_name(const std::string& dataset_name) {
+    std::string name = "routing_" + dataset_name;
+    std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)) && c != '_'; }, '_');
+    return name;
+}
+
+SharedDatasetSegment::SharedDatasetSegment(std::string name, bip::managed_shared_memory segment, bool created,
+                                           int users_fd, bool persistent)
+    : name_(std::move(name)), segment_(std::move(segment)), created_(created), users_fd_(users_fd),
+      persistent_(persistent) {
+    header_ = segment_.find<Header>("header").first;
+    points_ = segment_.find<PointVector>("points").first;
+    edges_ = segment_.find<EdgeVector>("edges").first;
+    rtree_ = segment_.find<RTree>("rtree").first;
+}
+
+SharedDatasetSegment::~SharedDatasetSegment() {
+    if (users_fd_ < 0) return;
+    try {
+        SegmentLock lock(name_);
+        // Converting to exclusive only succeeds once every other user of
+        // any generation of this name is gone. The users fd is closed
+        // before the segment lock, so no attach waits on it.
+        if (!persistent_ && ::flock(users_fd_, LOCK_EX | LOCK_NB) == 0 &&
+            bip::shared_memory_object::remove(name_.c_str())) {
+            std::cout << "Removed shared segment " << name_ << std::endl;
+        }
+        ::close(users_fd_);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to detach shared segment " << name_ << ": " << e.what() << std::endl;
+        ::close(users_fd_);
+    }
+}
+
+std::unique_ptr<SharedDatasetSegment> SharedDatasetSegment::attach(const std::string& name, const SourceStamp& stamp,
+                                                                   bool persistent) {
+    SegmentLock lock(name);
+
+    bip::managed_shared_memory segment;
+    try {
+        segment = bip::managed_shared_memory(bip::open_only, name.c_str());
+    } catch (const bip::interprocess_exception&) {
+        return nullptr;
+    }
+    auto header = segment.find<Header>("header").first;
+    if (!header || !header->complete || header->version != SEGMENT_VERSION || !(header->stamp == stamp)) {
+        if (!persistent) remove_if_unused(name);
+        return nullptr;
+    }
+    int users_fd = lock_users_file(name);
+    return std::unique_ptr<SharedDatasetSegment>(
+        new SharedDatasetSegment(name, std::move(segment), false, users_fd, persistent));
+}
+
+std::unique_ptr<SharedDatasetSegment> SharedDatasetSegment::create(const std::string& name, const SourceStamp& stamp,
+                                                                   const std::vector<std::pair<double, double>>& points,
+                                                                   const std::vector<EdgeSlot>& edges,
+                                                                   const std::vector<Value>& entries,
+                                                                   bool persistent) {
+    SegmentLock lock(name);
+
+    // R-tree nodes are hard to size up front: start from an estimate and
+    // double it if the segment runs out of space
+    size_t size = points.size() * sizeof(points[0]) + edges.size() * sizeof(EdgeSlot) +
+                  entries.size() * sizeof(Value) * 2 + (1u << 20);
+    for (int attempt = 0;; ++attempt, size *= 2) {
+        // Unlinking only removes the name; processes still attached to a
+        // stale segment keep their mapping
+        bip::shared_memory_object::remove(name.c_str());
+        try {
+            bip::managed_shared_memory segment(bip::create_only, name.c_str(), size);
+            auto* manager = segment.get_segment_manager();
+
+            auto* header = segment.construct<Header>("header")();
+            header->stamp = stamp;
+            header->generation = std::random_device{}() | (static_cast<uint64_t>(std::random_device{}()) << 32);
+
+            auto* shared_points = segment.construct<PointVector>("points")(Allocator<std::pair<double, double>>(manager));
+            shared_points->assign(points.begin(), points.end());
+            auto* shared_edges = segment.construct<EdgeVector>("edges")(Allocator<EdgeSlot>(manager));
+            shared_edges->assign(edges.begin(), edges.end());
+            segment.construct<RTree>("rtree")(entries.begin(), entries.end(), boost::geometry::index::quadratic<16>(),
+                                              boost::geometry::index::indexable<Value>(),
+                                              boost::geometry::index::equal_to<Value>(), Allocator<Value>(manager));
+
+            header->complete = true;
+            int users_fd = lock_users_file(name);
+            return std::unique_ptr<SharedDatasetSegment>(
+                new SharedDatasetSegment(name, std::move(segment), true, users_fd, persistent));
+        } catch (const bip::bad_alloc&) {
+            if (attempt >= 4) throw;
+            std::cerr << "Shared segment " << name << " too small (" << size << " bytes), retrying" << std::endl;
+        }
+    }
+}
+
+bool SharedDatasetSegment::unlink() const {
+    try {
+        SegmentLock lock(name_);
+        // Leave the name alone if it now belongs to a newer segment
+        try {
+            bip::managed_shared_memory current(bip::open_only, name_.c_str());
+            auto header = current.find<Header>("header").first;
+            if (header && header->generation != header_->generation) return false;
+        } catch (const bip::interprocess_exception&) {
+            return false;
+        }
+        return bip::shared_memory_object::remove(name_.c_str());
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to remove shared segment " << name_ << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+size_t SharedDatasetSegment::remove_unused() {
+    size_t removed = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(fs::temp_directory_path(), ec)) {
+        auto file = entry.path().filename().string();
+        if (file.rfind("routing_", 0) != 0 || entry.path().extension() != USERS_SUFFIX) continue;
+        auto name = entry.path().stem().string();
+        try {
+            SegmentLock lock(name);
+            if (remove_if_unused(name)) {
+                std::cout << "Removed unused shared segment " << name << std::endl;
+                ++removed;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to check shared segment " << name << ": " << e.what() << std::endl;
+        }
+    }
+    return removed;
+}
+
+const SharedDatasetSegment::EdgeSlot* SharedDatasetSegment::find_edge(uint32_t id) const {
+    auto it = std::lower_bound(edges_->begin(), edges_->end(), id,
+                               [](const EdgeSlot& slot, uint32_t key) { return slot.id < key; });
+    if (it == edges_->end() || it->id != id) return nullptr;
+    return &*it;
+}
@@ -0,0 +1,92 @@
+#include "shortcut_table.hpp"
+
+#include <stdexcept>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/exception.h>
+
+namespace {
+
+const char* const COLUMNS[] = {"incoming_edge", "outgoing_edge", "cost", "via_edge"};
+
+// Read an integer column of any width; nulls become null_value
+std::vector<int64_t> read_int_column(const arrow::Table& table, const std::string& name, int64_t null_value) {
+    auto column = table.GetColumnByName(name);
+    if (!column) throw std::runtime_error("Missing column in shortcuts table: " + name);
+
+    std::vector<int64_t> values;
+    values.reserve(column->length());
+    for (const auto& chunk : column->chunks()) {
+        for (int64_t i = 0; i < chunk->length(); ++i) {
+            if (chunk->IsNull(i)) {
+                values.push_back(null_value);
+                continue;
+            }
+            switch (column->type()->id()) {
+                case arrow::Type::INT32:
+                    values.push_back(std::static_pointer_cast<arrow::Int32Array>(chunk)->Value(i)); break;
+                case arrow::Type::INT64:
+                    values.push_back(std::static_pointer_cast<arrow::Int64Array>(chunk)->Value(i)); break;
+                case arrow::Type::UINT32:
+                    values.push_back(std::static_pointer_cast<arrow::UInt32Array>(chunk)->Value(i)); break;
+                case arrow::Type::UINT64:
+                    values.push_back(static_cast<int64_t>(std::static_pointer_cast<arrow::UInt64Array>(chunk)->Value(i))); break;
+                default:
+                    throw std::runtime_error("Unsupported type for column " + name + ": " + column->type()->ToString());
+            }
+        }
+    }
+    return values;
+}
+
+std::vector<double> read_cost_column(const arrow::Table& table, const std::string& name) {
+    auto column = table.GetColumnByName(name);
+    if (!column) throw std::runtime_error("Missing column in shortcuts table: " + name);
+
+    std::vector<double> values;
+    values.reserve(column->length());
+    for (const auto& chunk : column->chunks()) {
+        for (int64_t i = 0; i < chunk->length(); ++i) {
+            switch (column->type()->id()) {
+                case arrow::Type::DOUBLE:
+                    values.push_back(std::static_pointer_cast<arrow::DoubleArray>(chunk)->Value(i)); break;
+                case arrow::Type::FLOAT:
+                    values.push_back(std::static_pointer_cast<arrow::FloatArray>(chunk)->Value(i)); break;
+                default:
+                    throw std::runtime_error("Unsupported type for column " + name + ": " + column->type()->ToString());
+            }
+        }
+    }
+    return values;
+}
+
+} // namespace
+
+ShortcutTable read_shortcut_columns(const arrow::Table& table) {
+    ShortcutTable columns;
+    columns.from = read_int_column(table, "incoming_edge", ShortcutTable::NO_VIA);
+    columns.to = read_int_column(table, "outgoing_edge", ShortcutTable::NO_VIA);
+    columns.via = read_int_column(table, "via_edge", ShortcutTable::NO_VIA);
+    columns.cost = read_cost_column(table, "cost");
+    return columns;
+}
+
+ShortcutTable read_shortcut_table(const std::string& path) {
+    PARQUET_ASSIGN_OR_THROW(auto infile, arrow::io::ReadableFile::Open(path));
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+
+    // Skip every other column of the file
+    auto schema = reader->parquet_reader()->metadata()->schema();
+    std::vector<int> indices;
+    for (const char* name : COLUMNS) {
+        int index = schema->ColumnIndex(name);
+        if (index < 0) throw std::runtime_error(std::string("Missing column in shortcuts table: ") + name);
+        indices.push_back(index);
+    }
+    std::shared_ptr<arrow::Table> table;
+    PARQUET_THROW_NOT_OK(reader->ReadTable(indices, &table));
+    return read_shortcut_columns(*table);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "edge_reorder.hpp"
+#include "edges_csv.hpp"
+#include "test_utils.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/exception.h>
+
+namespace {
+
+// Edges 20 and 30 lie in the west, 10 and 40 in the east; ids interleave
+std::string write_test_edges() {
+    std::string path = temp_path("routing_test_reorder_edges.csv");
+    std::ofstream out(path);
+    out << "id,length,geometry\n";
+    out << "10,100,\"LINESTRING (-122.90 49.20, -122.89 49.20)\"\n";
+    out << "20,100,\"LINESTRING (-123.10 49.20, -123.09 49.20)\"\n";
+    out << "40,100,\"LINESTRING (-122.90 49.21, -122.89 49.21)\"\n";
+    out << "30,100,\"LINESTRING (-123.10 49.21, -123.09 49.21)\"\n";
+    return path;
+}
+
+// Rows: 20->30 (base), 10->40 (base), 30->99 (base), 20->99 via 30
+std::string write_test_shortcuts() {
+    return write_shortcuts_parquet(temp_path("routing_test_reorder_shortcuts.parquet"), {
+        {20, 30, -1, 1.0},
+        {10, 40, -1, 1.0},
+        {30, 99, -1, 1.0},
+        {20, 99, 30, 2.0},
+    });
+}
+
+std::vector<int64_t> read_ids(const arrow::Table& table, const std::string& name) {
+    std::vector<int64_t> ids;
+    for (const auto& chunk : table.GetColumnByName(name)->chunks()) {
+        auto values = std::static_pointer_cast<arrow::Int64Array>(chunk);
+        for (int64_t i = 0; i < chunk->length(); ++i) ids.push_back(chunk->IsNull(i) ? -1 : values->Value(i));
+    }
+    return ids;
+}
+
+} // namespace
+
+TEST(EdgeReorderTest, NumbersNearbyEdgesConsecutively) {
+    std::string shortcuts_out = temp_path("routing_test_reorder_out.parquet");
+    std::string edges_out = temp_path("routing_test_reorder_out.csv");
+    auto ordering = reorder_edges_hilbert(write_test_shortcuts(), write_test_edges(), shortcuts_out, edges_out);
+
+    ASSERT_EQ(ordering.original_ids.size(), 5u);
+    for (uint32_t id : {10u, 20u, 30u, 40u, 99u}) {
+        EXPECT_EQ(ordering.to_original(ordering.to_internal(id)), id);
+    }
+    EXPECT_EQ(ordering.to_internal(99), 4u); // no geometry: numbered last
+    EXPECT_EQ(ordering.to_internal(7), EdgeOrdering::UNKNOWN);
+
+    auto gap = [&](uint32_t a, uint32_t b) {
+        return std::abs(static_cast<int>(ordering.to_internal(a)) - static_cast<int>(ordering.to_internal(b)));
+    };
+    EXPECT_EQ(gap(20, 30), 1);
+    EXPECT_EQ(gap(10, 40), 1);
+}
+
+TEST(EdgeReorderTest, RewritesBothFiles) {
+    std::string shortcuts_out = temp_path("routing_test_reorder_out.parquet");
+    std::string edges_out = temp_path("routing_test_reorder_out.csv");
+    auto ordering = reorder_edges_hilbert(write_test_shortcuts(), write_test_edges(), shortcuts_out, edges_out);
+
+    // edges.csv: same header, rows in new id order, other columns untouched
+    std::ifstream in(edges_out);
+    std::string line;
+    ASSERT_TRUE(std::getline(in, line));
+    EXPECT_EQ(line, "id,length,geometry");
+    uint32_t expected = 0;
+    while (std::getline(in, line)) {
+        auto columns = parse_csv_line(line);
+        ASSERT_EQ(columns.size(), 3u);
+        EXPECT_EQ(std::stoul(columns[0]), expected++);
+        EXPECT_EQ(columns[1], "100");
+    }
+    EXPECT_EQ(expected, 4u);
+
+    std::shared_ptr<arrow::Table> table;
+    PARQUET_ASSIGN_OR_THROW(auto infile, arrow::io::ReadableFile::Open(shortcuts_out));
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+    PARQUET_THROW_NOT_OK(reader->ReadTable(&table));
+
+    auto from = read_ids(*table, "incoming_edge");
+    auto to = read_ids(*table, "outgoing_edge");
+    auto via = read_ids(*table, "via_edge");
+    EXPECT_EQ(from[0], ordering.to_internal(20));
+    EXPECT_EQ(to[1], ordering.to_internal(40));
+    EXPECT_EQ(to[2], ordering.to_internal(99));
+    EXPECT_EQ(via[3], ordering.to_internal(30));
+    EXPECT_EQ(via[0], -1); // null stays null
+}
+
+TEST(EdgeReorderTest, ReusesCachedCopiesUntilInputsChange) {
+    namespace fs = std::filesystem;
+    std::string shortcuts = write_test_shortcuts();
+    std::string edges = write_test_edges();
+    std::string cache_dir = temp_path("routing_test_reorder_cache");
+    fs::remove_all(cache_dir);
+
+    auto first = reorder_edges_hilbert_cached(shortcuts, edges, cache_dir);
+    EXPECT_TRUE(first.rebuilt);
+    EXPECT_TRUE(fs::exists(first.shortcuts_path));
+    EXPECT_TRUE(fs::exists(first.edges_path));
+
+    auto second = reorder_edges_hilbert_cached(shortcuts, edges, cache_dir);
+    EXPECT_FALSE(second.rebuilt);
+    EXPECT_EQ(second.ordering.original_ids, first.ordering.original_ids);
+    EXPECT_EQ(second.ordering.to_internal(99), first.ordering.to_internal(99));
+
+    // A newer input invalidates the copies
+    fs::last_write_time(edges, fs::last_write_time(edges) + std::chrono::seconds(5));
+    EXPECT_TRUE(reorder_edges_hilbert_cached(shortcuts, edges, cache_dir).rebuilt);
+    fs::remove_all(cache_dir);
+}
+
+TEST(EdgeReorderTest, FallbackCacheDirIsPerDataset) {
+    namespace fs = std::filesystem;
+    auto dirs = reorder_cache_dirs("/data/a/city/shortcuts.parquet", "/data/a/city/edges.csv");
+    ASSERT_EQ(dirs.size(), 2u);
+    EXPECT_EQ(dirs[0], "/data/a/city/hilbert");
+    EXPECT_EQ(fs::path(dirs[1]).parent_path(), fs::temp_directory_path());
+    EXPECT_EQ(fs::path(dirs[1]).filename().string().rfind("routing_hilbert_city_", 0), 0u);
+
+    // Same directory name elsewhere gets its own cache
+    auto other = reorder_cache_dirs("/data/b/city/shortcuts.parquet", "/data/b/city/edges.csv");
+    EXPECT_NE(other[1], dirs[1]);
+}
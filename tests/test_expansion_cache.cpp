@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "expansion_cache.hpp"
+
+#include <thread>
+
+TEST(ExpansionCacheTest, HitAndMiss) {
+    ShortcutExpansionCache cache;
+    std::vector<uint32_t> out;
+    EXPECT_FALSE(cache.append(1, 4, out));
+
+    cache.insert(1, 4, {1, 2, 3, 4});
+    EXPECT_TRUE(cache.append(1, 4, out));
+    EXPECT_TRUE(cache.append(1, 4, out, 1));
+    EXPECT_EQ(out, (std::vector<uint32_t>{1, 2, 3, 4, 2, 3, 4}));
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats["hits"], 2);
+    EXPECT_EQ(stats["misses"], 1);
+}
+
+TEST(ExpansionCacheTest, EvictsLeastRecentlyUsedWithinBudget) {
+    std::vector<uint32_t> span(100, 7);
+    ShortcutExpansionCache probe;
+    probe.insert(0, 0, span);
+    size_t entry_bytes = probe.stats()["bytes"];
+
+    // Room for two entries in one shard; the third insert evicts the least
+    // recently used
+    ShortcutExpansionCache cache(2 * entry_bytes, 1000, 1);
+    cache.insert(1, 2, span);
+    cache.insert(3, 4, span);
+    std::vector<uint32_t> out;
+    EXPECT_TRUE(cache.append(1, 2, out));
+    cache.insert(5, 6, span);
+
+    EXPECT_TRUE(cache.append(1, 2, out));
+    EXPECT_FALSE(cache.append(3, 4, out));
+    EXPECT_TRUE(cache.append(5, 6, out));
+    EXPECT_EQ(cache.stats()["evictions"], 1);
+}
+
+TEST(ExpansionCacheTest, PinnedEntriesSurviveEviction) {
+    std::vector<uint32_t> span(100, 7);
+    ShortcutExpansionCache probe;
+    probe.insert(0, 0, span);
+    size_t entry_bytes = probe.stats()["bytes"];
+
+    ShortcutExpansionCache cache(2 * entry_bytes, 2, 1);
+    std::vector<uint32_t> out;
+    cache.insert(1, 2, span);
+    cache.append(1, 2, out);
+    cache.append(1, 2, out); // Pinned after two hits
+    cache.insert(3, 4, span);
+    cache.insert(5, 6, span);
+    cache.insert(7, 8, span);
+
+    EXPECT_TRUE(cache.append(1, 2, out));
+    EXPECT_GT(cache.stats()["pinned_bytes"], 0);
+}
+
+TEST(ExpansionCacheTest, ShardsShareTheBudget) {
+    std::vector<uint32_t> span(100, 7);
+    ShortcutExpansionCache probe;
+    probe.insert(0, 0, span);
+    size_t entry_bytes = probe.stats()["bytes"];
+
+    // Threads filling and reading disjoint keys across 4 shards
+    ShortcutExpansionCache cache(40 * entry_bytes, 1000, 4);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<uint32_t> out;
+            for (uint32_t i = 0; i < 100; ++i) {
+                uint32_t from = t * 1000 + i;
+                if (!cache.append(from, from + 1, out)) cache.insert(from, from + 1, span);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats["misses"], 400);
+    EXPECT_LE(stats["bytes"].get<size_t>(), 40 * entry_bytes);
+    EXPECT_EQ(stats["entries"].get<size_t>() + stats["evictions"].get<size_t>(), 400u);
+}
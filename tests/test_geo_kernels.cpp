@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "geo_kernels.hpp"
+
+#include <random>
+#include <vector>
+
+TEST(GeoKernelsTest, Haversine) {
+    // One thousandth of a degree of latitude is ~111 m
+    EXPECT_NEAR(haversine_m(49.0, -123.0, 49.001, -123.0), 111.19, 0.01);
+    EXPECT_DOUBLE_EQ(haversine_m(49.0, -123.0, 49.0, -123.0), 0.0);
+
+    std::vector<std::pair<double, double>> line = {{49.0, -123.0}, {49.001, -123.0}, {49.002, -123.0}};
+    EXPECT_NEAR(polyline_length_m(line.data(), line.size()), 222.39, 0.01);
+}
+
+TEST(GeoKernelsTest, PointPolylineDistance) {
+    // Query point 0.0005 deg of latitude north of a horizontal segment's middle
+    std::vector<std::pair<double, double>> line = {{49.0, -123.001}, {49.0, -122.999}};
+    EXPECT_NEAR(point_polyline_distance_m(49.0005, -123.0, line.data(), line.size()), 55.66, 0.01);
+
+    // Past the end the closest point is the endpoint
+    std::vector<std::pair<double, double>> single = {{49.0, -123.0}};
+    EXPECT_NEAR(point_polyline_distance_m(49.001, -123.0, single.data(), single.size()), 111.32, 0.01);
+}
+
+TEST(GeoKernelsTest, BatchKernelMatchesScalar) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> jitter(-0.01, 0.01);
+    for (int iter = 0; iter < 200; ++iter) {
+        // Mostly short polylines as in road data, plus empty and single points
+        std::vector<std::vector<std::pair<double, double>>> lines(1 + rng() % 17);
+        for (auto& line : lines) {
+            line.resize(rng() % 6 == 0 ? rng() % 23 : 2 + rng() % 3);
+            for (auto& p : line) p = {49.25 + jitter(rng), -123.0 + jitter(rng)};
+            if (line.size() > 2) line[1] = line[0]; // zero-length segment
+        }
+        std::vector<PolylineRef> refs;
+        for (const auto& line : lines) refs.push_back({line.data(), line.size()});
+
+        std::vector<double> fast(refs.size()), reference(refs.size());
+        point_polylines_distance_m(49.25, -123.0, refs.data(), refs.size(), fast.data());
+        point_polylines_distance_m_scalar(49.25, -123.0, refs.data(), refs.size(), reference.data());
+        for (size_t i = 0; i < refs.size(); ++i) EXPECT_NEAR(fast[i], reference[i], 1e-6);
+    }
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "metric_customizer.hpp"
+#include "shortcut_table.hpp"
+#include "test_utils.hpp"
+
+#include <cstdio>
+
+namespace {
+
+// Rows: 1->2 (base, 5), 2->3 (base, 7), 3->4 (base, 2),
+//       1->3 via 2 (12), 1->4 via 3 (14)
+std::string write_test_shortcuts() {
+    return write_shortcuts_parquet(temp_path("routing_test_shortcuts.parquet"), {
+        {1, 2, -1, 5.0},
+        {2, 3, -1, 7.0},
+        {3, 4, -1, 2.0},
+        {1, 3, 2, 12.0},
+        {1, 4, 3, 14.0},
+    });
+}
+
+// Two ways from 1 to 4: via 2 (5 + 5) and via 3 (6 + 6). The shortcut
+// 1->4 was built through 2, which places 2 and 3 below 1 and 4.
+std::string write_diamond_shortcuts() {
+    return write_shortcuts_parquet(temp_path("routing_test_diamond_shortcuts.parquet"), {
+        {1, 2, -1, 5.0},
+        {2, 4, -1, 5.0},
+        {1, 3, -1, 6.0},
+        {3, 4, -1, 6.0},
+        {1, 4, 2, 10.0},
+    });
+}
+
+} // namespace
+
+TEST(MetricCustomizerTest, RecomputesDependentShortcuts) {
+    MetricCustomizer customizer(write_test_shortcuts());
+
+    auto stats = customizer.apply({{2, 10.0}}, false, 2);
+    EXPECT_EQ(stats.base_updated, 1u);
+    EXPECT_EQ(stats.shortcuts_updated, 2u); // 1->3, then 1->4 on top of it
+    EXPECT_EQ(stats.levels, 3u);
+
+    const auto& costs = customizer.costs();
+    EXPECT_DOUBLE_EQ(costs[1], 10.0);
+    EXPECT_DOUBLE_EQ(costs[3], 15.0);
+    EXPECT_DOUBLE_EQ(costs[4], 17.0);
+    EXPECT_DOUBLE_EQ(costs[0], 5.0);
+}
+
+TEST(MetricCustomizerTest, ResetRestoresOriginalCosts) {
+    MetricCustomizer customizer(write_test_shortcuts());
+    customizer.apply({{2, 10.0}}, false, 1);
+    customizer.apply({{3, 4.0}}, true, 1);
+
+    const auto& costs = customizer.costs();
+    EXPECT_DOUBLE_EQ(costs[1], 7.0);
+    EXPECT_DOUBLE_EQ(costs[3], 12.0);
+    EXPECT_DOUBLE_EQ(costs[4], 16.0);
+}
+
+TEST(MetricCustomizerTest, IncreaseMovesViaToCheaperTriangle) {
+    MetricCustomizer customizer(write_diamond_shortcuts());
+
+    auto stats = customizer.apply({{2, 20.0}}, false, 1);
+    EXPECT_EQ(stats.shortcuts_updated, 1u);
+    EXPECT_EQ(stats.vias_changed, 1u);
+    EXPECT_DOUBLE_EQ(customizer.costs()[4], 12.0);
+    EXPECT_EQ(customizer.vias()[4], 3);
+
+    // The changed base row and the moved shortcut
+    EXPECT_EQ(customizer.changed_rows(), (std::vector<uint32_t>{1, 4}));
+}
+
+TEST(MetricCustomizerTest, DecreaseFindsTriangleOffStoredVia) {
+    MetricCustomizer customizer(write_diamond_shortcuts());
+
+    customizer.apply({{3, 1.0}}, false, 1);
+    EXPECT_DOUBLE_EQ(customizer.costs()[4], 7.0);
+    EXPECT_EQ(customizer.vias()[4], 3);
+
+    // Reset brings back the stored via and reports the rows it restored
+    auto stats = customizer.apply({}, true, 1);
+    EXPECT_EQ(stats.vias_changed, 1u);
+    EXPECT_DOUBLE_EQ(customizer.costs()[4], 10.0);
+    EXPECT_EQ(customizer.vias()[4], 2);
+    EXPECT_EQ(customizer.changed_rows().size(), 2u);
+    EXPECT_GT(customizer.memory_bytes(), 0u);
+}
+
+TEST(MetricCustomizerTest, WriteStoresCurrentCostsAndVias) {
+    MetricCustomizer customizer(write_diamond_shortcuts());
+    customizer.apply({{2, 20.0}}, false, 1);
+
+    auto path = temp_path("routing_test_customized.parquet");
+    customizer.write(path);
+    auto table = read_shortcut_table(path);
+    std::remove(path.c_str());
+
+    ASSERT_EQ(table.size(), 5u);
+    EXPECT_EQ(table.cost, customizer.costs());
+    EXPECT_EQ(table.via[4], 3);
+    // Base rows keep their null via edge
+    EXPECT_EQ(table.via[1], ShortcutTable::NO_VIA);
+    EXPECT_EQ(table.from[4], 1);
+    EXPECT_EQ(table.to[4], 4);
+}
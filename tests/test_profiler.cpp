@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "profiler.hpp"
+
+#include <memory>
+#include <new>
+#include <vector>
+
+TEST(ProfilerTest, CountsThreadAllocations) {
+    if (!allocation_counters_available()) GTEST_SKIP() << "built without ROUTING_PROFILE_ALLOCATIONS";
+    uint64_t before = thread_allocation_count();
+    uint64_t bytes_before = thread_allocated_bytes();
+    auto p = std::make_unique<std::vector<int>>(1000);
+    EXPECT_GE(thread_allocation_count() - before, 2u);
+    EXPECT_GE(thread_allocated_bytes() - bytes_before, 1000 * sizeof(int));
+}
+
+TEST(ProfilerTest, RecordsStages) {
+    RequestProfiler profiler(true);
+    profiler.begin("alloc");
+    std::vector<std::unique_ptr<int>> v;
+    for (int i = 0; i < 10; ++i) v.push_back(std::make_unique<int>(i));
+    profiler.end();
+    profiler.begin("idle");
+    profiler.end();
+
+    ASSERT_EQ(profiler.stages().size(), 2u);
+    EXPECT_EQ(profiler.stages()[0].first, "alloc");
+    EXPECT_GE(profiler.stages()[0].second.allocations, allocation_counters_available() ? 10u : 0u);
+    EXPECT_EQ(profiler.stages()[1].second.allocations, 0u);
+
+    auto json = profiler.to_json();
+    EXPECT_TRUE(json["stages"].contains("alloc"));
+    EXPECT_TRUE(json.contains("perf_counters"));
+    EXPECT_TRUE(json.contains("allocation_counters"));
+}
+
+TEST(ProfilerTest, CountsAllNewForms) {
+    if (!allocation_counters_available()) GTEST_SKIP() << "built without ROUTING_PROFILE_ALLOCATIONS";
+    struct alignas(64) Wide { char bytes[64]; };
+    uint64_t before = thread_allocation_count();
+    delete[] new int[4];
+    delete new (std::nothrow) int(1);
+    delete new Wide;
+    delete[] new Wide[2];
+    EXPECT_EQ(thread_allocation_count() - before, 4u);
+}
+
+TEST(ProfilerTest, DisabledProfilerRecordsNothing) {
+    RequestProfiler profiler(false);
+    profiler.begin("search");
+    profiler.end();
+    EXPECT_TRUE(profiler.stages().empty());
+
+    ProfileAggregator aggregator;
+    aggregator.record(profiler, "ignored");
+    EXPECT_EQ(aggregator.to_json()["requests"], 0);
+}
+
+TEST(ProfilerTest, AggregatesRequests) {
+    ProfileAggregator aggregator;
+    for (int i = 0; i < 3; ++i) {
+        RequestProfiler profiler(true);
+        profiler.begin("search");
+        profiler.end();
+        aggregator.record(profiler, "test/default");
+    }
+    auto json = aggregator.to_json();
+    EXPECT_EQ(json["requests"], 3);
+    EXPECT_EQ(json["stages"]["search"]["count"], 3);
+    EXPECT_EQ(json["slowest"].size(), 3u);
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include "reference_router.hpp"
+#include "test_utils.hpp"
+
+#include <cmath>
+
+namespace {
+
+// Rows: 1->2 (base, 5), 2->3 (base, 7), 3->4 (base, 2), 1->5 (base, 20),
+//       5->4 (base, 1), 1->4 via 3 (1, cheaper than any base path)
+std::string write_reference_shortcuts() {
+    return write_shortcuts_parquet(temp_path("routing_test_reference.parquet"), {
+        {1, 2, -1, 5.0},
+        {2, 3, -1, 7.0},
+        {3, 4, -1, 2.0},
+        {1, 5, -1, 20.0},
+        {5, 4, -1, 1.0},
+        {1, 4, 3, 1.0},
+    });
+}
+
+} // namespace
+
+TEST(ReferenceRouterTest, IgnoresShortcutRows) {
+    ReferenceRouter router(write_reference_shortcuts());
+    EXPECT_EQ(router.edge_count(), 5u);
+    EXPECT_EQ(router.arc_count(), 5u);
+
+    // 1->2->3->4 = 14 beats 1->5->4 = 21; the 1->4 shortcut is not an arc
+    EXPECT_DOUBLE_EQ(router.query({{1, 0.0}}, {{4, 0.0}}), 14.0);
+}
+
+TEST(ReferenceRouterTest, AddsSeedOffsets) {
+    ReferenceRouter router(write_reference_shortcuts());
+    EXPECT_DOUBLE_EQ(router.query({{1, 1.5}}, {{3, 0.5}}), 14.0);
+    // Cheapest over all seed pairs: from 2 (offset 4) to 4 (offset 1) = 14
+    EXPECT_DOUBLE_EQ(router.query({{1, 3.0}, {2, 4.0}}, {{4, 1.0}, {5, 30.0}}), 14.0);
+    // Same edge on both ends costs only the offsets
+    EXPECT_DOUBLE_EQ(router.query({{3, 2.0}}, {{3, 1.0}}), 3.0);
+}
+
+TEST(ReferenceRouterTest, UnreachableIsInfinite) {
+    ReferenceRouter router(write_reference_shortcuts());
+    EXPECT_TRUE(std::isinf(router.query({{4, 0.0}}, {{1, 0.0}})));
+    EXPECT_TRUE(std::isinf(router.query({{99, 0.0}}, {{4, 0.0}})));
+    EXPECT_TRUE(std::isinf(router.query({{1, 0.0}}, {})));
+}
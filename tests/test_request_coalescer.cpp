@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+#include "request_coalescer.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(RequestCoalescerTest, IdenticalConcurrentRequestsComputeOnce) {
+    RequestCoalescer coalescer;
+    std::atomic<int> computations{0};
+    auto slow = [&]() {
+        ++computations;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return nlohmann::json{{"distance", 42}};
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<nlohmann::json> results(8);
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i]() { results[i] = coalescer.run("same", slow); });
+    }
+    for (auto& t : threads) t.join();
+
+    for (const auto& r : results) EXPECT_EQ(r["distance"], 42);
+    auto stats = coalescer.stats();
+    EXPECT_EQ(stats["computed"], computations.load());
+    EXPECT_EQ(stats["computed"].get<int>() + stats["coalesced"].get<int>(), 8);
+    EXPECT_LT(computations.load(), 8);
+}
+
+TEST(RequestCoalescerTest, DistinctKeysAndSequentialCallsAreNotShared) {
+    RequestCoalescer coalescer;
+    int computations = 0;
+    auto compute = [&]() { return nlohmann::json{{"n", ++computations}}; };
+
+    EXPECT_EQ(coalescer.run("a", compute)["n"], 1);
+    EXPECT_EQ(coalescer.run("a", compute)["n"], 2);
+    EXPECT_EQ(coalescer.run("b", compute)["n"], 3);
+    EXPECT_EQ(coalescer.stats()["coalesced"], 0);
+}
+
+TEST(RequestCoalescerTest, LeaderExceptionPropagates) {
+    RequestCoalescer coalescer;
+    EXPECT_THROW(coalescer.run("k", []() -> nlohmann::json { throw std::runtime_error("boom"); }),
+                 std::runtime_error);
+    // The failed flight is cleared
+    EXPECT_EQ(coalescer.run("k", []() { return nlohmann::json{{"ok", true}}; })["ok"], true);
+}
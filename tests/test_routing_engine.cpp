@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 #include "routing_engine.hpp"
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
 
 // Basic test for routing engine
 TEST(RoutingEngineTest, DatasetLoading) {
@@ -13,6 +18,97 @@ TEST(RoutingEngineTest, DatasetLoading) {
     EXPECT_TRUE(datasets.empty());
 }
 
+TEST(RoutingEngineTest, DatasetLoadingSpatialIndex) {
+    RoutingEngine engine;
+
+    // Unknown backends are rejected, known ones still need the files
+    EXPECT_FALSE(engine.load_dataset("nonexistent", "/tmp", "", "", "quadtree"));
+    EXPECT_FALSE(engine.load_dataset("nonexistent", "/tmp", "", "", "h3"));
+    EXPECT_TRUE(engine.find_nearest_edges("nonexistent", 49.25, -123.0).empty());
+}
+
+TEST(RoutingEngineTest, LazyLoadingWithoutDatasets) {
+    RoutingEngine engine;
+    engine.configure_lazy_loading("/nonexistent", true, 1024);
+
+    // Nothing registered: no dataset covers any point and routes still fail cleanly
+    EXPECT_TRUE(engine.resolve_dataset(49.25, -123.0, 49.26, -123.1).empty());
+    auto result = engine.compute_route("burnaby", 49.25, -123.0, 49.26, -123.1);
+    EXPECT_FALSE(result["success"]);
+    EXPECT_EQ(engine.memory_used_bytes(), 0u);
+    EXPECT_EQ(engine.memory_budget_bytes(), 1024u);
+}
+
+TEST(RoutingEngineTest, LazyLoadingEvictsOnlyScannedDatasets) {
+    auto grid = write_grid_dataset("routing_test_lazy/grid", 4, 4);
+    auto root = std::filesystem::path(grid.dir).parent_path().string();
+    RoutingEngine engine;
+    engine.configure_lazy_loading(root, true, 1);
+    EXPECT_EQ(engine.resolve_dataset(49.251, -122.999, 49.255, -122.995), "grid");
+    EXPECT_TRUE(std::filesystem::exists(grid.dir + "/bounds"));
+
+    // Loaded on first use; alone it stays even though it exceeds the budget
+    engine.compute_route("grid", 49.251, -122.999, 49.255, -122.995);
+    EXPECT_EQ(engine.get_loaded_datasets(), std::vector<std::string>{"grid"});
+
+    // An explicit load pushes the scanned dataset out but is never evicted itself
+    ASSERT_TRUE(engine.load_dataset("explicit", "", grid.shortcuts_path, grid.edges_path));
+    EXPECT_EQ(engine.get_loaded_datasets(), std::vector<std::string>{"explicit"});
+
+    // Unloading forgets the files, so the dataset is not loaded again
+    engine.unload_dataset("grid");
+    EXPECT_NE(engine.resolve_dataset(49.251, -122.999, 49.255, -122.995), "grid");
+    EXPECT_FALSE(engine.compute_route("grid", 49.251, -122.999, 49.255, -122.995)["success"]);
+    EXPECT_EQ(engine.get_loaded_datasets(), std::vector<std::string>{"explicit"});
+}
+
+TEST(RoutingEngineTest, LazyLoadingKeepsOverriddenDatasets) {
+    auto a = write_grid_dataset("routing_test_lazy_weights/a", 4, 4);
+    auto b = write_grid_dataset("routing_test_lazy_weights/b", 4, 4, 49.30);
+    auto root = std::filesystem::path(a.dir).parent_path().string();
+    RoutingEngine engine;
+    engine.configure_lazy_loading(root, true, 1);
+
+    // /weights loads a registered dataset like a route does
+    auto update = engine.update_weights("a", {{0, 1000.0}});
+    ASSERT_TRUE(update["success"]) << update.dump();
+
+    // Over budget, but evicting "a" would lose its overrides
+    engine.compute_route("b", 49.301, -122.999, 49.305, -122.995);
+    auto loaded = engine.get_loaded_datasets();
+    std::sort(loaded.begin(), loaded.end());
+    EXPECT_EQ(loaded, (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(RoutingEngineTest, NearestEdgesBatchWithoutDataset) {
+    RoutingEngine engine;
+    std::vector<std::pair<double, double>> points = {{49.25, -123.0}, {49.26, -123.1}, {49.27, -123.2}};
+
+    // One (empty) result per input point
+    auto results = engine.find_nearest_edges_batch("nonexistent", points, 500.0, 3, 2);
+    ASSERT_EQ(results.size(), points.size());
+    for (const auto& r : results) EXPECT_TRUE(r.empty());
+}
+
+TEST(RoutingEngineTest, NearestEdgesBatchWithHelpersMatchesSingleLookups) {
+    auto grid = write_grid_dataset("routing_test_batch_grid", 6, 6);
+    RoutingEngine engine;
+    ASSERT_TRUE(engine.load_dataset("grid", "", grid.shortcuts_path, grid.edges_path));
+
+    // Large enough to be split across helper threads
+    std::vector<std::pair<double, double>> points;
+    for (int i = 0; i < 5000; ++i) {
+        points.push_back({49.25 + 0.015 * (i % 71) / 71.0, -123.0 + 0.015 * (i % 67) / 67.0});
+    }
+    auto results = engine.find_nearest_edges_batch("grid", points, 500.0, 2, 4);
+    ASSERT_EQ(results.size(), points.size());
+    for (size_t i = 0; i < points.size(); i += 97) {
+        auto single = engine.find_nearest_edges("grid", points[i].first, points[i].second, 500.0, 2);
+        ASSERT_EQ(results[i].size(), single.size()) << i;
+        for (size_t j = 0; j < single.size(); ++j) EXPECT_NEAR(results[i][j].second, single[j].second, 1e-9);
+    }
+}
+
 // Basic test for route computation
 TEST(RoutingEngineTest, RouteComputation) {
     RoutingEngine engine;
@@ -32,6 +128,146 @@ TEST(RoutingEngineTest, RouteComputationOneToOne) {
     EXPECT_TRUE(result.contains("error"));
 }
 
+TEST(RoutingEngineTest, RouteComputationShortOutputs) {
+    RoutingEngine engine;
+    for (auto output : {RouteOutput::Edges, RouteOutput::Distance}) {
+        auto result = engine.compute_route("test", 0, 0, 1, 1, 1000, 5, "default", false, output);
+        EXPECT_FALSE(result["success"]);
+        EXPECT_TRUE(result.contains("error"));
+    }
+}
+
+TEST(RoutingEngineTest, DistanceOutputMatchesFull) {
+    auto grid = write_grid_dataset("routing_test_output_grid", 6, 6);
+    RoutingEngine engine;
+    ASSERT_TRUE(engine.load_dataset("grid", "", grid.shortcuts_path, grid.edges_path));
+
+    for (const std::string mode : {"default", "one_to_one"}) {
+        auto full = engine.compute_route("grid", 49.2515, -122.9985, 49.2635, -122.9865, 1000.0, 5, mode,
+                                         false, RouteOutput::Full);
+        auto distance = engine.compute_route("grid", 49.2515, -122.9985, 49.2635, -122.9865, 1000.0, 5, mode,
+                                             false, RouteOutput::Distance);
+        ASSERT_TRUE(full["success"]) << mode;
+        ASSERT_TRUE(distance["success"]) << mode;
+        EXPECT_DOUBLE_EQ(distance["route"]["distance"].get<double>(), full["route"]["distance"].get<double>());
+        EXPECT_TRUE(full["route"].contains("path"));
+
+        // Cost only: nothing unpacked, no geometry or debug info
+        EXPECT_FALSE(distance["route"].contains("path"));
+        EXPECT_FALSE(distance["route"].contains("geojson"));
+        EXPECT_FALSE(distance["route"].contains("distance_meters"));
+        EXPECT_FALSE(distance.contains("debug"));
+    }
+}
+
+TEST(RoutingEngineTest, CandidatePruningStats) {
+    RoutingEngine engine;
+    engine.configure_candidate_pruning(false, 0.0);
+
+    // Failed routes never reach the search, so nothing is counted
+    engine.compute_route("test", 0, 0, 1, 1, 1000, 5);
+    auto stats = engine.get_pruning_stats();
+    EXPECT_FALSE(stats["enabled"]);
+    EXPECT_EQ(stats["queries"], 0);
+    EXPECT_DOUBLE_EQ(stats["pruned_ratio"].get<double>(), 0.0);
+}
+
+TEST(RoutingEngineTest, RTreeNearestMatchesExhaustive) {
+    // Long diagonals have large boxes, which come out of the R-tree before
+    // closer short edges whose boxes are farther
+    auto grid = write_grid_dataset("routing_test_nearest_grid", 6, 6, 49.25, -123.0, 0.01);
+    RoutingEngine engine;
+    ASSERT_TRUE(engine.load_dataset("grid", "", grid.shortcuts_path, grid.edges_path));
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> lat(49.25, 49.30), lng(-123.0, -122.95);
+    for (int i = 0; i < 200; ++i) {
+        double qlat = lat(rng), qlng = lng(rng);
+        auto all = engine.find_nearest_edges("grid", qlat, qlng, 5000.0, 1000);
+        ASSERT_GE(all.size(), 4u);
+        auto nearest = engine.find_nearest_edges("grid", qlat, qlng, 5000.0, 4);
+        ASSERT_EQ(nearest.size(), 4u);
+        for (size_t j = 0; j < nearest.size(); ++j) {
+            EXPECT_NEAR(nearest[j].second, all[j].second, 1e-9) << qlat << "," << qlng;
+        }
+    }
+}
+
+TEST(RoutingEngineTest, H3MatchesRTree) {
+    auto grid = write_grid_dataset("routing_test_h3_grid", 8, 8);
+    RoutingEngine engine;
+    ASSERT_TRUE(engine.load_dataset("grid_rtree", "", grid.shortcuts_path, grid.edges_path, "rtree"));
+    ASSERT_TRUE(engine.load_dataset("grid_h3", "", grid.shortcuts_path, grid.edges_path, "h3"));
+
+    // Points inside and just around the grid, so diagonals that only clip a
+    // cell corner and the early-stop bound both get exercised
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> lat(49.249, 49.272), lng(-123.001, -122.978);
+    for (int i = 0; i < 200; ++i) {
+        double qlat = lat(rng), qlng = lng(rng);
+
+        // Everything in the radius: same edges with the same distances
+        auto all_rtree = engine.find_nearest_edges("grid_rtree", qlat, qlng, 400.0, 1000);
+        auto all_h3 = engine.find_nearest_edges("grid_h3", qlat, qlng, 400.0, 1000);
+        std::sort(all_rtree.begin(), all_rtree.end());
+        std::sort(all_h3.begin(), all_h3.end());
+        ASSERT_EQ(all_rtree.size(), all_h3.size()) << qlat << "," << qlng;
+        for (size_t j = 0; j < all_rtree.size(); ++j) {
+            EXPECT_EQ(all_rtree[j].first, all_h3[j].first);
+            EXPECT_NEAR(all_rtree[j].second, all_h3[j].second, 1e-6);
+        }
+
+        // Nearest few: two-way roads tie, so compare distances only
+        auto near_rtree = engine.find_nearest_edges("grid_rtree", qlat, qlng, 1000.0, 5);
+        auto near_h3 = engine.find_nearest_edges("grid_h3", qlat, qlng, 1000.0, 5);
+        ASSERT_EQ(near_rtree.size(), near_h3.size());
+        for (size_t j = 0; j < near_rtree.size(); ++j) {
+            EXPECT_NEAR(near_rtree[j].second, near_h3[j].second, 1e-6) << qlat << "," << qlng;
+        }
+    }
+
+    // A radius far beyond the ring cap still answers from the capped disk
+    auto capped = engine.find_nearest_edges("grid_h3", 49.26, -122.99, 1e9, 3);
+    EXPECT_EQ(capped.size(), 3u);
+}
+
+TEST(RoutingEngineTest, CandidatePruningDropsDominatedSeeds) {
+    auto grid = write_grid_dataset("routing_test_pruning_grid", 8, 8);
+    RoutingEngine engine;
+    ASSERT_TRUE(engine.load_dataset("grid", "", grid.shortcuts_path, grid.edges_path));
+
+    // Start and end on neighbouring edges in the grid corner, every edge of
+    // the grid as a seed. The nearest pair costs at most a few edges
+    // (< 60 s), while seeds across the grid are over 1.5 km away (> 100 s
+    // approach alone), so they are dominated whatever the network leg.
+    auto route = [&](bool prune) {
+        engine.configure_candidate_pruning(prune, 40.0);
+        return engine.compute_route("grid", 49.25, -122.9985, 49.25, -122.9955, 5000.0, 1000, "default",
+                                    false, RouteOutput::Distance);
+    };
+    auto unpruned = route(false);
+    EXPECT_EQ(engine.get_pruning_stats()["queries"], 0);
+    auto pruned = route(true);
+    ASSERT_TRUE(unpruned["success"]);
+    ASSERT_TRUE(pruned["success"]);
+    // Distance output carries no debug info, pruning included
+    EXPECT_FALSE(pruned.contains("debug"));
+
+    auto stats = engine.get_pruning_stats();
+    EXPECT_EQ(stats["queries"], 1);
+    EXPECT_GT(stats["seeds_pruned"].get<uint64_t>(), 0u);
+    EXPECT_LT(stats["seeds_kept"].get<uint64_t>(), 2 * grid.edge_count);
+    EXPECT_DOUBLE_EQ(pruned["route"]["distance"].get<double>(), unpruned["route"]["distance"].get<double>());
+
+    // An override faster than the bound switches pruning off until reset
+    ASSERT_TRUE(engine.update_weights("grid", {{0, 0.1}})["success"]);
+    ASSERT_TRUE(route(true)["success"]);
+    EXPECT_EQ(engine.get_pruning_stats()["queries"], 1);
+    ASSERT_TRUE(engine.update_weights("grid", {}, true)["success"]);
+    ASSERT_TRUE(route(true)["success"]);
+    EXPECT_EQ(engine.get_pruning_stats()["queries"], 2);
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include "shared_dataset.hpp"
+
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+using Segment = SharedDatasetSegment;
+
+const Segment::SourceStamp STAMP{100, 1, 200, 2, false};
+
+// Segment names carry the pid so concurrent test runs do not collide
+std::string test_segment(const std::string& name) {
+    return Segment::segment_name(name + "_" + std::to_string(getpid()));
+}
+
+// Two edges: id 7 (two points) and id 3 (three points)
+struct TestData {
+    std::vector<std::pair<double, double>> points = {
+        {49.20, -123.00}, {49.21, -123.00},
+        {49.30, -122.90}, {49.31, -122.90}, {49.32, -122.91}
+    };
+    std::vector<Segment::EdgeSlot> edges = {{3, {2, 3, 2500.0}}, {7, {0, 2, 1100.0}}};
+    std::vector<Segment::Value> entries = {
+        {Segment::Box(Segment::Point(-123.00, 49.20), Segment::Point(-123.00, 49.21)), 7},
+        {Segment::Box(Segment::Point(-122.91, 49.30), Segment::Point(-122.90, 49.32)), 3}
+    };
+};
+
+} // namespace
+
+TEST(SharedDatasetTest, SegmentNameIsSanitized) {
+    EXPECT_EQ(Segment::segment_name("test/attach"), "routing_test_attach");
+    EXPECT_EQ(Segment::segment_name("a.b-c"), "routing_a_b_c");
+}
+
+TEST(SharedDatasetTest, AttachSharesOneSegment) {
+    std::string name = test_segment("test_attach");
+    TestData data;
+    auto owner = Segment::create(name, STAMP, data.points, data.edges, data.entries);
+    ASSERT_TRUE(owner);
+    EXPECT_TRUE(owner->created());
+
+    auto reader = Segment::attach(name, STAMP);
+    ASSERT_TRUE(reader);
+    EXPECT_FALSE(reader->created());
+    EXPECT_EQ(reader->points().size(), 5u);
+    EXPECT_EQ(reader->edge_count(), 2u);
+    EXPECT_EQ(reader->rtree_size(), 2u);
+
+    const auto* slot = reader->find_edge(3);
+    ASSERT_NE(slot, nullptr);
+    EXPECT_EQ(slot->geometry.offset, 2u);
+    EXPECT_DOUBLE_EQ(reader->points()[slot->geometry.offset].first, 49.30);
+    EXPECT_EQ(reader->find_edge(5), nullptr);
+
+    std::vector<Segment::Value> hits;
+    reader->query_until(boost::geometry::index::nearest(Segment::Point(-123.0, 49.2), 2), [&](const auto& value) {
+        hits.push_back(value);
+        return false;
+    });
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].second, 7u);
+
+    // The segment stays while anyone maps it, and goes with the last user
+    owner.reset();
+    EXPECT_TRUE(Segment::attach(name, STAMP));
+    reader.reset();
+    EXPECT_FALSE(Segment::attach(name, STAMP));
+}
+
+TEST(SharedDatasetTest, PersistentSegmentOutlivesUsers) {
+    std::string name = test_segment("test_persistent");
+    TestData data;
+    auto owner = Segment::create(name, STAMP, data.points, data.edges, data.entries, true);
+    ASSERT_TRUE(owner);
+
+    // As across a restart
+    owner.reset();
+    auto reader = Segment::attach(name, STAMP, true);
+    ASSERT_TRUE(reader);
+
+    // Only an explicit unlink removes it; the mapping stays usable
+    EXPECT_TRUE(reader->unlink());
+    EXPECT_FALSE(Segment::attach(name, STAMP, true));
+    EXPECT_EQ(reader->points().size(), 5u);
+}
+
+TEST(SharedDatasetTest, RemoveUnusedKeepsMappedSegments) {
+    std::string name = test_segment("test_unused");
+    TestData data;
+    // A persistent detach leaves the segment behind, as a crash would
+    Segment::create(name, STAMP, data.points, data.edges, data.entries, true).reset();
+    auto other = Segment::create(test_segment("test_mapped"), STAMP, data.points, data.edges, data.entries);
+    ASSERT_TRUE(other);
+
+    EXPECT_GE(Segment::remove_unused(), 1u);
+    EXPECT_FALSE(Segment::attach(name, STAMP, true));
+    EXPECT_TRUE(Segment::attach(other->name(), STAMP));
+}
+
+TEST(SharedDatasetTest, StaleSegmentIsNotAttached) {
+    std::string name = test_segment("test_stale");
+    TestData data;
+    auto owner = Segment::create(name, STAMP, data.points, data.edges, data.entries);
+    ASSERT_TRUE(owner);
+
+    auto changed = STAMP;
+    changed.edges_mtime += 1;
+    EXPECT_FALSE(Segment::attach(name, changed));
+
+    // Rebuilding replaces the name; the old mapping stays usable
+    auto rebuilt = Segment::create(name, changed, data.points, data.edges, data.entries);
+    ASSERT_TRUE(rebuilt);
+    EXPECT_EQ(owner->points().size(), 5u);
+
+    // The old segment no longer owns the name, so unlinking it is a no-op.
+    // Its users still count: the name goes once both are detached.
+    EXPECT_FALSE(owner->unlink());
+    owner.reset();
+    EXPECT_TRUE(Segment::attach(name, changed));
+    rebuilt.reset();
+    EXPECT_FALSE(Segment::attach(name, changed));
+}
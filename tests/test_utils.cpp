@@ -0,0 +1,116 @@
+#include "test_utils.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+#include <unistd.h>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+
+#include "h3_utils.hpp"
+
+std::string temp_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / (std::to_string(getpid()) + "_" + name)).string();
+}
+
+std::string write_shortcuts_parquet(const std::string& path, const std::vector<ShortcutRow>& rows) {
+    arrow::Int64Builder from, to, via;
+    arrow::DoubleBuilder cost;
+    for (const auto& row : rows) {
+        PARQUET_THROW_NOT_OK(from.Append(row.from));
+        PARQUET_THROW_NOT_OK(to.Append(row.to));
+        PARQUET_THROW_NOT_OK(row.via < 0 ? via.AppendNull() : via.Append(row.via));
+        PARQUET_THROW_NOT_OK(cost.Append(row.cost));
+    }
+
+    std::shared_ptr<arrow::Array> from_a, to_a, via_a, cost_a;
+    PARQUET_THROW_NOT_OK(from.Finish(&from_a));
+    PARQUET_THROW_NOT_OK(to.Finish(&to_a));
+    PARQUET_THROW_NOT_OK(via.Finish(&via_a));
+    PARQUET_THROW_NOT_OK(cost.Finish(&cost_a));
+    auto schema = arrow::schema({
+        arrow::field("incoming_edge", arrow::int64()),
+        arrow::field("outgoing_edge", arrow::int64()),
+        arrow::field("cost", arrow::float64()),
+        arrow::field("via_edge", arrow::int64())
+    });
+    auto table = arrow::Table::Make(schema, {from_a, to_a, cost_a, via_a});
+
+    PARQUET_ASSIGN_OR_THROW(auto outfile, arrow::io::FileOutputStream::Open(path));
+    PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(*table, arrow::default_memory_pool(), outfile, 1024));
+    PARQUET_THROW_NOT_OK(outfile->Close());
+    return path;
+}
+
+GridDataset write_grid_dataset(const std::string& name, int rows, int cols,
+                               double lat0, double lng0, double spacing_deg) {
+    GridDataset result;
+    result.dir = temp_path(name);
+    std::filesystem::remove_all(result.dir);
+    std::filesystem::create_directories(result.dir);
+    result.shortcuts_path = result.dir + "/shortcuts.parquet";
+    result.edges_path = result.dir + "/edges.csv";
+
+    struct Edge { int from, to; double length_m; };
+    auto lat_of = [&](int node) { return lat0 + (node / cols) * spacing_deg; };
+    auto lng_of = [&](int node) { return lng0 + (node % cols) * spacing_deg; };
+    auto length_m = [&](int a, int b) {
+        constexpr double M_PER_DEG = 111195.0;
+        double dy = (lat_of(b) - lat_of(a)) * M_PER_DEG;
+        double dx = (lng_of(b) - lng_of(a)) * M_PER_DEG * std::cos((lat_of(a) + lat_of(b)) / 2 * M_PI / 180.0);
+        return std::hypot(dx, dy);
+    };
+
+    std::vector<Edge> edges;
+    auto add_road = [&](int a, int b) {
+        edges.push_back({a, b, length_m(a, b)});
+        edges.push_back({b, a, length_m(a, b)});
+    };
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            int node = r * cols + c;
+            if (c + 1 < cols) add_road(node, node + 1);
+            if (r + 1 < rows) add_road(node, node + cols);
+            if (r + 1 < rows && c + 1 < cols) add_road(node, node + cols + 1);
+        }
+    }
+    result.edge_count = edges.size();
+
+    // Cells at the finest resolution; the lowest common ancestor decides lca_res
+    constexpr int CELL_RES = 15;
+    std::ofstream out(result.edges_path);
+    out << "id,source,target,length,highway,incoming_cell,outgoing_cell,lca_res,geometry\n";
+    out << std::setprecision(10);
+    for (size_t id = 0; id < edges.size(); ++id) {
+        const auto& e = edges[id];
+        uint64_t in_cell = h3_lat_lng_to_cell(lat_of(e.from), lng_of(e.from), CELL_RES);
+        uint64_t out_cell = h3_lat_lng_to_cell(lat_of(e.to), lng_of(e.to), CELL_RES);
+        int lca_res = -1;
+        for (int res = CELL_RES; res >= 0; --res) {
+            if (h3_find_ancestor(in_cell, res) == h3_find_ancestor(out_cell, res)) {
+                lca_res = res;
+                break;
+            }
+        }
+        out << id << "," << e.from << "," << e.to << "," << e.length_m << ",residential,"
+            << in_cell << "," << out_cell << "," << lca_res << ",\"LINESTRING ("
+            << lng_of(e.from) << " " << lat_of(e.from) << ", "
+            << lng_of(e.to) << " " << lat_of(e.to) << ")\"\n";
+    }
+
+    std::vector<std::vector<int64_t>> out_edges(rows * cols);
+    for (size_t id = 0; id < edges.size(); ++id) out_edges[edges[id].from].push_back(static_cast<int64_t>(id));
+    std::vector<ShortcutRow> shortcut_rows;
+    for (size_t id = 0; id < edges.size(); ++id) {
+        for (int64_t next : out_edges[edges[id].to]) {
+            shortcut_rows.push_back({static_cast<int64_t>(id), next, -1, edges[id].length_m / 13.89});
+        }
+    }
+    write_shortcuts_parquet(result.shortcuts_path, shortcut_rows);
+    return result;
+}
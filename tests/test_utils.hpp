@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Fixtures shared by the routing-server tests
+
+// File name in the temp directory, prefixed with the process id so
+// concurrent test runs do not overwrite each other's fixtures
+std::string temp_path(const std::string& name);
+
+// One shortcut table row; a negative via is written as null
+struct ShortcutRow {
+    int64_t from;
+    int64_t to;
+    int64_t via;
+    double cost;
+};
+
+// Write rows as a shortcut table (int64 ids, double costs) and return path
+std::string write_shortcuts_parquet(const std::string& path, const std::vector<ShortcutRow>& rows);
+
+// Small road network: a rows x cols grid of nodes spacing_deg apart from
+// (lat0, lng0), joined by two-way edges to the four neighbours and one
+// two-way diagonal per cell. shortcuts.parquet holds only base rows (every
+// edge into a node -> every edge out of it, cost = travel time of the
+// incoming edge at 13.89 m/s), so any search over it is exact.
+struct GridDataset {
+    std::string dir;
+    std::string shortcuts_path;
+    std::string edges_path;
+    size_t edge_count = 0;
+};
+GridDataset write_grid_dataset(const std::string& name, int rows, int cols,
+                               double lat0 = 49.25, double lng0 = -123.0, double spacing_deg = 0.003);